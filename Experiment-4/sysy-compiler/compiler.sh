@@ -1,4 +1,3 @@
 # # build/compiler -koopa test/hello.c -o test/hello.koopa
-build/compiler -lex test/hello.c -o test/hello_lex.txt
-build/compiler -ast test/hello.c -o test/hello_ast.txt
-build/compiler -semantic test/hello.c -o test/hello_semantic.txt
\ No newline at end of file
+# 只扫描和解析一遍, 三种输出都由同一棵 AST 得到
+build/compiler -lex -ast -semantic test/hello.c -o test/hello_lex.txt -o test/hello_ast.txt -o test/hello_semantic.txt
\ No newline at end of file
@@ -2,256 +2,326 @@
 
 #include <cassert>
 #include <cstdio>
+#include <initializer_list>
 #include <iostream>
-#include <map>
 #include <memory>
-#include <set>
 #include <stack>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
-
-extern int yylineno;
-
-typedef struct{
-  int type;
-  int value;
-  std::string name;
-}Symbol;
-
-typedef std::map<std::string, Symbol> SymbolMap;
+#include "Arena.h"
+#include "Intern.h"
+#include "Location.h"
+#include "SymbolTable.h"
 
 typedef struct func_symbol{
-  int depth;
   int block_end;
   std::stack<int> loop_stack;
-  std::vector<SymbolMap> symbol_maps;
-  std::set<std::string> nameset;
+  // void 函数的调用不能当成值用
+  bool is_void;
   func_symbol(){
-    depth = 0;
     block_end = 0;
+    is_void = false;
   }
 } FuncSymbol;
 
-typedef std::map<std::string, std::unique_ptr<func_symbol>> FuncSymbolMap;
+typedef std::unordered_map<Sym, std::unique_ptr<func_symbol>> FuncSymbolMap;
 
+// 变量和函数分开存, 变量 (包括全局变量) 都在带作用域的 vars 里
 typedef struct{
-  SymbolMap symbol_map;
+  ScopedSymbolTable vars;
   FuncSymbolMap func_symbol_map;
 } SymbolTable;
 
-static SymbolTable symbol_table;
-static func_symbol* current_func_symbol_table = NULL;
-static std::string current_func_name = "";
+// 所有结点的种类, 顺序和下面类的定义顺序一致
+enum class ASTKind : uint8_t {
+  CompUnit,
+  CompUnits,
+  FuncDef_,
+  BType,
+  FuncDefOrVarDecl,
+  Decl,
+  ConstDecl,
+  ConstDef,
+  Bracket,
+  ConstInitVal,
+  Brace,
+  ConstExp,
+  VarDecl,
+  VarDecl_,
+  VarDef,
+  InitVal,
+  FuncDef,
+  FuncType,
+  FuncFParams,
+  FuncFParam,
+  Block,
+  BlockItem,
+  Stmt,
+  Exp,
+  LVal,
+  PrimaryExp,
+  Number,
+  UnaryExp,
+  UnaryOp,
+  FuncRParams,
+  MulExp,
+  AddExp,
+  RelExp,
+  EqExp,
+  LAndExp,
+  LOrExp,
+  Expr,
+};
 
-static int identDepth = 0;
+// StmtAST 的种类, 由 sysy.y 在归约时设置
+enum class StmtKind : uint8_t {
+  Empty,      // ';'
+  Exp,        // Exp ';'
+  Assign,     // LVal '=' Exp ';'
+  Block,
+  Return,
+  If,
+  While,
+  Break,
+  Continue,
+};
+
+// 一元 / 二元运算符
+enum class OpKind : uint8_t {
+  None,
+  Add,
+  Sub,
+  Not,
+  Mul,
+  Div,
+  Mod,
+  Lt,
+  Gt,
+  Le,
+  Ge,
+  Eq,
+  Ne,
+  And,
+  Or,
+};
+
+#include "KoopaIR.h"
+#include "Compilation.h"
+
+// 常量表达式里的二元运算
+static int Eval_Binary(OpKind op, int lhs, int rhs){
+  int result;
+  if (!KoopaGen::Fold(op, lhs, rhs, result)){
+    ctx->Diag() << "Error: division by zero in constant expression." << std::endl;
+    ctx->Fail(1);
+  }
+  return result;
+}
+
+// 生成 Koopa IR 的遍历状态, 每次 Dump / Dump_Exp 各有一份
+typedef struct{
+  // 表达式的值: 孩子处理完把值压栈, 父结点弹出用到的, 再压入自己的值
+  std::vector<Value> values;
+  // 还没处理完的 if / while / && / || 的标号编号
+  std::vector<int> labels;
+} DumpState;
 
 // 所有 AST 的基类
+// 结点统一从当前编译单元的 arena 分配, delete 什么都不做, 内存随 arena 整块回收
 class BaseAST {
  public:
+  static void *operator new(size_t size){
+    return ctx->arena.Alloc(size);
+  }
+  static void operator delete(void *){
+  }
+  const ASTKind kind;
+  // 产生这个结点的产生式的第一个 token 的位置, 放在 kind 后面的填充里, 不占额外空间
+  // 第一个 token 不是名字的产生式 (形参) 在动作里改成名字的位置
+  Loc loc;
+  explicit BaseAST(ASTKind kind) : kind(kind), loc(ctx->ast_loc) {}
   virtual ~BaseAST() = default;
-	virtual void Dump() const = 0;
-  virtual void Semantic_Analysis(){
-    return;
+
+  // 第 i 个孩子, 按 -ast 的输出顺序, 空的不算, 没有了返回 NULL
+  // -ast 不输出的 BType 不算孩子
+  virtual const BaseAST *Child(uint32_t) const {
+    return NULL;
   }
-  virtual void Print_AST(){
-    return;
+  // 交出所有孩子 (包括不算孩子的 BType) 的所有权, 析构时用, 见文件末尾的 Destroy_AST
+  virtual void Take_Children(std::vector<BaseAST *> &){
+  }
+
+  // 下面几个遍历都由 ASTWalk.h 的 Walk_AST 驱动, 不递归, 定义在文件末尾
+  // 遍历的处理都不在结点上: 语义分析见 Semantic.h, 生成 Koopa IR 和常量求值见文件末尾的 DumpPass / EvalPass
+  // 生成 Koopa IR
+  void Dump() const;
+  // 表达式生成 Koopa IR, 返回表达式的值
+  Value Dump_Exp() const;
+  // 常量表达式求值, 用于常量定义, 数组长度和全局变量的初值
+  int Eval() const;
+};
+
+// unique_ptr<BaseAST> 析构时不沿着孩子一层层递归, 整棵树用显式栈拆掉, 见文件末尾的 Destroy_AST
+namespace std {
+template <>
+struct default_delete<BaseAST> {
+  default_delete() = default;
+  // unique_ptr<XxxAST> 可以转成 unique_ptr<BaseAST>
+  template <typename T>
+  default_delete(const default_delete<T> &) {}
+  void operator()(BaseAST *node) const;
+};
+}
+
+#include "ASTWalk.h"
+
+// 列表的存储也从 arena 分配: 结点不析构, 放在普通堆上的数组就收不回来了
+// 扩容时旧的数组留在 arena 里, 最多多占一倍, 随 arena 一起释放
+template <typename T>
+struct ASTAllocator {
+  typedef T value_type;
+  ASTAllocator() = default;
+  template <typename U>
+  ASTAllocator(const ASTAllocator<U> &) {}
+  T *allocate(size_t n) {
+    return (T *) ctx->arena.Alloc(n * sizeof(T), alignof(T));
+  }
+  void deallocate(T *, size_t) {
+  }
+  template <typename U>
+  bool operator==(const ASTAllocator<U> &) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const ASTAllocator<U> &) const {
+    return false;
+  }
+};
+
+// 列表 (顶层定义, 语句, 逗号分隔的定义和初值) 的孩子连续存放, 遍历时不用沿着链表一层层递归
+// -ast 的输出格式仍然是原来链表的嵌套形状, 由 FlatAST 按下标还原
+typedef std::vector<std::unique_ptr<BaseAST>, ASTAllocator<std::unique_ptr<BaseAST>>> ASTList;
+
+// Child 的实现: 依次列出成员, 跳过空的, 取第 i 个
+static const BaseAST *Nth_Child(uint32_t i, std::initializer_list<const BaseAST *> children){
+  for (const BaseAST *child : children){
+    if (child && i-- == 0){
+      return child;
+    }
   }
-};	
+  return NULL;
+}
+
+static const BaseAST *Nth_Child(uint32_t i, const ASTList &list){
+  return i < list.size() ? list[i].get() : NULL;
+}
 
-// CompUnit 是 BaseAST
+// Take_Children 的实现
+static void Take_Child(std::vector<BaseAST *> &out, std::unique_ptr<BaseAST> &child){
+  if (child){
+    out.push_back(child.release());
+  }
+}
+
+static void Take_Child(std::vector<BaseAST *> &out, ASTList &list){
+  for (auto &child : list){
+    Take_Child(out, child);
+  }
+  list.clear();
+}
+
+static Value Pop_Value(DumpState &s){
+  Value v = s.values.back();
+  s.values.pop_back();
+  return v;
+}
+
+// 二元运算, 两边的值都已经在栈上
+static void Dump_Binary(DumpState &s, OpKind op){
+  Value rhs = Pop_Value(s);
+  Value lhs = Pop_Value(s);
+  s.values.push_back(ctx->koopa.Binary(op, lhs, rhs));
+}
+
+static void Eval_Binary(std::vector<int> &values, OpKind op){
+  int rhs = values.back();
+  values.pop_back();
+  values.back() = Eval_Binary(op, values.back(), rhs);
+}
+
+// CompUnit ::= [CompUnit] (Decl | FuncDef)
 // CompUnit ::= CompUnits
 class CompUnitAST : public BaseAST{
 public:
+  CompUnitAST() : BaseAST(ASTKind::CompUnit) {}
   std::unique_ptr<BaseAST> comp_units;
-	void Dump() const override {
-      if (comp_units){
-        comp_units->Dump();
-      }
-	}
-  void Print_AST() override {
-    // ident depth
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-		std::cout << "CompUnitAST {" << std::endl;
-    comp_units->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    comp_units->Semantic_Analysis();
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {comp_units.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, comp_units);
   }
 };
 
 // CompUnits ::= [CompUnits] (FuncDefOrVarDecl | ConstDecl)
+// items 依次是每个顶层的 FuncDefOrVarDecl / ConstDecl / FuncDef_ (void 函数)
 class CompUnitsAST : public BaseAST{
 public:
-  std::unique_ptr<BaseAST> comp_units;
-  std::unique_ptr<BaseAST> funcdef_or_vardecl;
-  std::unique_ptr<BaseAST> const_decl;
-  std::unique_ptr<BaseAST> func_def;
-	void Dump() const override {
-    if(comp_units){
-      comp_units->Dump();
-    }
-    if (funcdef_or_vardecl){
-      funcdef_or_vardecl->Dump();
-    }
-    if (const_decl){
-      const_decl->Dump();
-    }
-    if (func_def){
-      func_def->Dump();
-    }
-	}
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-		std::cout << "CompUnitsAST {" << std::endl;
-    if(comp_units){
-      comp_units->Print_AST();
-    }
-    if (funcdef_or_vardecl){
-      funcdef_or_vardecl->Print_AST();
-    }
-    if (const_decl){
-      const_decl->Print_AST();
-    }
-    if (func_def){
-      func_def->Print_AST();
-    }    
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-	}
-  void Semantic_Analysis() override {
-    if(comp_units){
-      comp_units->Semantic_Analysis();
-    }
-    if (funcdef_or_vardecl){
-      funcdef_or_vardecl->Semantic_Analysis();
-    }
-    if (const_decl){
-      const_decl->Semantic_Analysis();
-    }
-    if (func_def){
-      func_def->Semantic_Analysis();
-    }
-	}
+  CompUnitsAST() : BaseAST(ASTKind::CompUnits) {}
+  ASTList items;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, items);
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, items);
+  }
 };
 
 // FuncDef_ ::= IDENT '(' [FuncFParams] ')' Block
 class FuncDefAST_ : public BaseAST {
  public:
+  FuncDefAST_() : BaseAST(ASTKind::FuncDef_) {}
   std::string func_type;
-  std::string ident;
+  Sym ident = kNoSym;
   std::unique_ptr<BaseAST> func_f_params;
   std::unique_ptr<BaseAST> block;
-
-  void Dump() const override {
-    if(func_f_params){
-      func_f_params->Dump();
-    }
-    block->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "FuncDefAST { " << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "TYPE: " << func_type << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "IDENT: " << ident << std::endl;
-    identDepth ++;
-    if(func_f_params){
-      func_f_params->Print_AST();
-    }
-    block->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    // redefinition check
-    if (symbol_table.func_symbol_map.find(ident) != symbol_table.func_symbol_map.end()){
-      std::cout << "Error: type B redefinition of function " << ident << " at line: " << yylineno << std::endl;
-      exit(1);
-    }
-
-    if(func_f_params){
-      func_f_params->Semantic_Analysis();
-    }
-
-    symbol_table.func_symbol_map[ident] = std::make_unique<func_symbol>();
-
-    current_func_symbol_table = symbol_table.func_symbol_map[ident].get();
-    SymbolMap m;
-    current_func_symbol_table->symbol_maps.push_back(m);
-    current_func_symbol_table->block_end = 0;
-
-
-    block->Semantic_Analysis();
-
-    current_func_symbol_table->symbol_maps.pop_back();
-    current_func_symbol_table = NULL;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {func_f_params.get(), block.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, func_f_params);
+    Take_Child(out, block);
   }
 };
 
 // BType ::= "int"
 class BTypeAST : public BaseAST{
   public:
+    BTypeAST() : BaseAST(ASTKind::BType) {}
     std::string type;
-  void Dump() const override {
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "BTypeAST {" << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "TYPE: " << type << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
 };
 
 // FuncDefOrVarDecl ::= BType FuncDef_ | BType VarDecl_
 class FuncDefOrVarDeclAST : public BaseAST{
   public:
+    FuncDefOrVarDeclAST() : BaseAST(ASTKind::FuncDefOrVarDecl) {}
     std::unique_ptr<BaseAST> b_type;
     std::unique_ptr<BaseAST> func_def;
     std::unique_ptr<BaseAST> var_decl;
-  void Dump() const override {
-    if (func_def){
-      ((FuncDefAST_ *) func_def.get())->func_type = ((BTypeAST *) b_type.get())->type;
-      func_def->Dump();
-    }else if (var_decl){
-      var_decl->Dump();
-    }
-    if(b_type){
-      b_type->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {func_def.get(), var_decl.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FuncDefOrVarDeclAST {" << std::endl;
-    if (func_def){
-      ((FuncDefAST_ *) func_def.get())->func_type = ((BTypeAST *) b_type.get())->type;
-      func_def->Print_AST();
-    }
-    if (var_decl){
-      var_decl->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, b_type);
+    Take_Child(out, func_def);
+    Take_Child(out, var_decl);
   }
-  void Semantic_Analysis() override {
+  // 函数的返回类型写在 BType 里, 进入函数之前交给 FuncDef_
+  void Set_Func_Type() const {
     if (func_def){
       ((FuncDefAST_ *) func_def.get())->func_type = ((BTypeAST *) b_type.get())->type;
-      func_def->Semantic_Analysis();
-    }
-    if (var_decl){
-      var_decl->Semantic_Analysis();
     }
   }
 };
@@ -259,62 +329,33 @@ class FuncDefOrVarDeclAST : public BaseAST{
 // Decl ::= ConstDecl | VarDecl
 class DeclAST : public BaseAST{
   public:
+    DeclAST() : BaseAST(ASTKind::Decl) {}
     std::unique_ptr<BaseAST> const_decl;
     std::unique_ptr<BaseAST> var_decl;
-  void Dump() const override {
-    if (const_decl){
-      const_decl->Dump();
-    }
-    if (var_decl){
-      var_decl->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {const_decl.get(), var_decl.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "DeclAST {" << std::endl;
-    if (const_decl){
-      const_decl->Print_AST();
-    }
-    if (var_decl){
-      var_decl->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    if (const_decl){
-      const_decl->Semantic_Analysis();
-    }
-    if (var_decl){
-      var_decl->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, const_decl);
+    Take_Child(out, var_decl);
   }
 };
 
 // ConstDecl ::= "const" BType ConstDef { ',' ConstDef } ';'
 class ConstDeclAST : public BaseAST{
   public:
+    ConstDeclAST() : BaseAST(ASTKind::ConstDecl) {}
     std::unique_ptr<BaseAST> b_type;
-    std::unique_ptr<BaseAST> const_def;
-  void Dump() const override {
-    b_type->Dump();
-    const_def->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "ConstDeclAST {" << std::endl;
-    b_type->Print_AST();
-    const_def->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    b_type->Semantic_Analysis();
-    const_def->Semantic_Analysis();
+    ASTList const_defs;
+  const BaseAST *Child(uint32_t i) const override {
+    if (b_type && i-- == 0){
+      return b_type.get();
+    }
+    return Nth_Child(i, const_defs);
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, b_type);
+    Take_Child(out, const_defs);
   }
 };
 
@@ -322,81 +363,32 @@ class ConstDeclAST : public BaseAST{
 // ConstDef ::= IDENT [ Bracket ] "=" ConstInitVal
 class ConstDefAST : public BaseAST{
   public:
-    std::string ident;
+    ConstDefAST() : BaseAST(ASTKind::ConstDef) {}
+    Sym ident = kNoSym;
     std::unique_ptr<BaseAST> bracket;
     std::unique_ptr<BaseAST> const_init_val;
-    std::unique_ptr<BaseAST> const_def;
-  void Dump() const override {
-    const_init_val->Dump();
-    if(bracket){
-      bracket->Dump();
-    }
-    if (const_def){
-      const_def->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {bracket.get(), const_init_val.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "ConstDefAST {" << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "IDENT: " << ident << std::endl;
-    identDepth ++;
-    if(bracket){
-      bracket->Print_AST();
-    }
-    const_init_val->Print_AST();
-    if (const_def){
-      const_def->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    const_init_val->Semantic_Analysis();
-    if(bracket){
-      bracket->Semantic_Analysis();
-    }
-    if (const_def){
-      const_def->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, bracket);
+    Take_Child(out, const_init_val);
   }
 };
 
 // Bracket ::= '[' ConstExp ']' [ Bracket ]
 class BracketAST : public BaseAST{
   public:
+    BracketAST() : BaseAST(ASTKind::Bracket) {}
     std::unique_ptr<BaseAST> const_exp;
     std::unique_ptr<BaseAST> bracket;
-  void Dump() const override {
-    if (const_exp){
-      const_exp->Dump();
-    }
-    if (bracket){
-      bracket->Dump();
-    }
+  // 数组长度由 VarDef / ConstDef 求值, 下标由 LVal 生成
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {const_exp.get(), bracket.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "BracketAST {" << std::endl;
-    if (const_exp){
-      const_exp->Print_AST();
-    }
-    if (bracket){
-      bracket->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    if (const_exp){
-      const_exp->Semantic_Analysis();
-    }
-    if (bracket){
-      bracket->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, const_exp);
+    Take_Child(out, bracket);
   }
 };
 
@@ -404,215 +396,92 @@ class BracketAST : public BaseAST{
 // ConstInitVal ::= ConstExp | '{' [ Brace ] '}'
 class ConstInitValAST : public BaseAST{
   public:
+    ConstInitValAST() : BaseAST(ASTKind::ConstInitVal) {}
     std::unique_ptr<BaseAST> const_exp;
     std::unique_ptr<BaseAST> brace;
-  void Dump() const override {
-    const_exp->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "ConstInitValAST {" << std::endl;
-    if(const_exp){
-      const_exp->Print_AST();
-    }
-    if(brace){
-      brace->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+  // 初值由 ConstDef / VarDef 展开
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {const_exp.get(), brace.get()});
   }
-  void Semantic_Analysis() override{
-    if(const_exp){
-      const_exp->Semantic_Analysis();
-    }
-    if(brace){
-      brace->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, const_exp);
+    Take_Child(out, brace);
   }
 };
 
 // Brace ::= ConstInitVal [ ',' Brace ]
+// items 依次是花括号里的每个 ConstInitVal / InitVal
 class BraceAST : public BaseAST{
   public:
-    std::unique_ptr<BaseAST> const_init_val;
-    std::unique_ptr<BaseAST> brace;
-  void Dump() const override {
-    const_init_val->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "BraceAST {" << std::endl;
-    if (const_init_val){
-      const_init_val->Print_AST();
-    }
-    if(brace){
-      brace->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+    BraceAST() : BaseAST(ASTKind::Brace) {}
+    ASTList items;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, items);
   }
-  void Semantic_Analysis() override {
-    if (const_init_val){
-      const_init_val->Semantic_Analysis();
-    }
-    if (brace){
-      brace->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, items);
   }
 };
 
 // ConstExp ::= Exp
-// ConstExp ::= Exp [ ',' ConstExp ]
 class ConstExpAST : public BaseAST{
   public:
+    ConstExpAST() : BaseAST(ASTKind::ConstExp) {}
     std::unique_ptr<BaseAST> exp;
-    std::unique_ptr<BaseAST> const_exp;
-  void Dump() const override {
-    exp->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "ConstExpAST {" << std::endl;
-    exp->Print_AST();
-    if(const_exp){
-      const_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    exp->Semantic_Analysis();
-    if (const_exp){
-      const_exp->Semantic_Analysis();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {exp.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, exp);
   }
 };
 
 // VarDecl ::= BType VarDef { ',' VarDef } ';'
 class VarDeclAST : public BaseAST{
   public:
+    VarDeclAST() : BaseAST(ASTKind::VarDecl) {}
     std::unique_ptr<BaseAST> b_type;
-    std::unique_ptr<BaseAST> var_def;
-  void Dump() const override {
-    if (b_type){
-      b_type->Dump();
-    }
-    if (var_def){
-      var_def->Dump();
+    ASTList var_defs;
+  const BaseAST *Child(uint32_t i) const override {
+    if (b_type && i-- == 0){
+      return b_type.get();
     }
+    return Nth_Child(i, var_defs);
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "VarDeclAST {" << std::endl;
-    b_type->Print_AST();
-    var_def->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    b_type->Semantic_Analysis();
-    var_def->Semantic_Analysis();
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, b_type);
+    Take_Child(out, var_defs);
   }
 };
 
 // VarDecl_ ::= VarDef { ',' VarDef } ';'
 class VarDeclAST_ : public BaseAST{
   public:
-    std::unique_ptr<BaseAST> var_def;
-  void Dump() const override {
-    var_def->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "VarDeclAST_ {" << std::endl;
-    var_def->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    var_def->Semantic_Analysis();
+    VarDeclAST_() : BaseAST(ASTKind::VarDecl_) {}
+    ASTList var_defs;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, var_defs);
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, var_defs);
   }
 };
 
 // VarDef ::= IDENT [ '[' ConstExp ']' ] | IDENT [ '[' ConstExp ']' ] "=" InitVal
-// VarDef ::= IDENT [ Bracket ] [ ',' VarDef ] 
-//          | IDENT [ Bracket ] "=" InitVal [ ',' VarDef ] 
+// VarDef ::= IDENT [ Bracket ] [ ',' VarDef ]
+//          | IDENT [ Bracket ] "=" InitVal [ ',' VarDef ]
 class VarDefAST : public BaseAST{
   public:
-    std::string ident;
+    VarDefAST() : BaseAST(ASTKind::VarDef) {}
+    Sym ident = kNoSym;
     std::unique_ptr<BaseAST> bracket;
     std::unique_ptr<BaseAST> init_val;
-    std::unique_ptr<BaseAST> var_def;
-  void Dump() const override {
-    if (init_val){
-      init_val->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {bracket.get(), init_val.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "VarDefAST { " << std::endl;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "IDENT: " << ident << std::endl;
-    identDepth ++;
-    if(bracket){
-      bracket->Print_AST();
-    }
-    if (init_val){
-      init_val->Print_AST();
-    }
-    if (var_def){
-      var_def->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    // redefinition
-    if (current_func_symbol_table == NULL){
-      if (symbol_table.symbol_map.find(ident) != symbol_table.symbol_map.end()){
-        std::cout << "Error: type B redefinition of global variable " << ident << " at line: " << yylineno << std::endl;
-        exit(1);
-      }
-
-      if (init_val){
-        symbol_table.symbol_map[ident] = {0, 0, ident + "_00"};
-      }else {
-        symbol_table.symbol_map[ident] = {0, 0, ident + "_00"};
-      }
-    }else {
-      if (current_func_symbol_table->nameset.count(ident + std::string("_") + std::to_string(current_func_symbol_table->depth)) != 0){
-        std::cout << "Error: type B redefinition of variable " << ident << " at line: " << yylineno << std::endl;
-        exit(1);
-      }
-
-      if (init_val){
-        current_func_symbol_table->nameset.insert(ident + std::string("_") + std::to_string(current_func_symbol_table->depth));
-        current_func_symbol_table->symbol_maps[current_func_symbol_table->depth][ident] = {0, 0, ident + std::string("_") + std::to_string(current_func_symbol_table->depth)};
-      }else {
-        current_func_symbol_table->nameset.insert(ident + std::string("_") + std::to_string(current_func_symbol_table->depth));
-        current_func_symbol_table->symbol_maps[current_func_symbol_table->depth][ident] = {0, 0, ident + std::string("_") + std::to_string(current_func_symbol_table->depth)};
-      }
-    }
-    if(bracket){
-      bracket->Semantic_Analysis();
-    }
-    if (init_val){
-      init_val->Semantic_Analysis();
-    }
-    if (var_def){
-      var_def->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, bracket);
+    Take_Child(out, init_val);
   }
 };
 
@@ -620,110 +489,56 @@ class VarDefAST : public BaseAST{
 // InitVal ::= Exp | '{' [ Brace ] '}'
 class InitValAST : public BaseAST{
   public:
+    InitValAST() : BaseAST(ASTKind::InitVal) {}
     std::unique_ptr<BaseAST> exp;
     std::unique_ptr<BaseAST> brace;
-  void Dump() const override {
-    exp->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "InitValAST {" << std::endl;
-    if(exp){
-      exp->Print_AST();
-    }
-    if(brace){
-      brace->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+  // 初值由 VarDef 展开
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {exp.get(), brace.get()});
   }
-  void Semantic_Analysis() override{
-    if (exp){
-      exp->Semantic_Analysis();
-    }
-    if(brace){
-      brace->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, exp);
+    Take_Child(out, brace);
   }
 };
 
 // FuncDef ::= FuncType IDENT '(' [FuncFParams] ')' Block
 class FuncDefAST : public BaseAST {
  public:
+  FuncDefAST() : BaseAST(ASTKind::FuncDef) {}
   std::unique_ptr<BaseAST> func_type;
-  std::string ident;
+  Sym ident = kNoSym;
   std::unique_ptr<BaseAST> func_f_params;
   std::unique_ptr<BaseAST> block;
-
-  void Dump() const override {
-    func_type->Dump();
-    if(func_f_params){
-      func_f_params->Dump();
-    }
-    block->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FuncDefAST {" << std::endl;
-    func_type->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "IDENT:" << ident << std::endl;
-    identDepth ++;
-    if(func_f_params){
-      func_f_params->Print_AST();
-    }
-    block->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    func_type->Semantic_Analysis();
-    if(func_f_params){
-      func_f_params->Semantic_Analysis();
-    }
-    block->Semantic_Analysis();
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {func_type.get(), func_f_params.get(), block.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, func_type);
+    Take_Child(out, func_f_params);
+    Take_Child(out, block);
   }
 };
 
 // FuncType ::= "int" | "void"
 class FuncTypeAST : public BaseAST{
   public:
+    FuncTypeAST() : BaseAST(ASTKind::FuncType) {}
     std::string type;
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FunctypeAST {" << std::endl;
-    std::cout << type;
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
 
 };
 
 // FuncFParams ::= FuncFParam { ',' FuncFParam }
 class FuncFParamsAST : public BaseAST{
   public:
+    FuncFParamsAST() : BaseAST(ASTKind::FuncFParams) {}
     std::unique_ptr<BaseAST> func_f_param;
-  void Dump() const override {
-    func_f_param->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FuncFParamsAST {" << std::endl;
-    func_f_param->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+  // 形参由 FuncDef_ 生成
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {func_f_param.get()});
   }
-  void Semantic_Analysis() override{
-    func_f_param->Semantic_Analysis();
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, func_f_param);
   }
 };
 
@@ -731,267 +546,91 @@ class FuncFParamsAST : public BaseAST{
 // FuncFParam ::= BType IDENT [ '['  ']' [ Bracket ]]
 class FuncFParamAST : public BaseAST{
   public:
+    FuncFParamAST() : BaseAST(ASTKind::FuncFParam) {}
     std::unique_ptr<BaseAST> b_type;
-    std::string ident;
+    Sym ident = kNoSym;
+    // 带 '[' ']' 的数组形参, bracket 是第一维之后的长度
+    bool is_array = false;
     std::unique_ptr<BaseAST> bracket;
     std::unique_ptr<BaseAST> func_f_param;
-  void Dump() const override {
-    b_type->Dump();
-    if (func_f_param){
-      func_f_param->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {bracket.get(), func_f_param.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FuncFParamAST {" << std::endl;
-    b_type->Print_AST();
-    identDepth--;
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "IDENT: " << ident << std::endl;
-    identDepth ++;
-    if(bracket){
-      bracket->Print_AST();
-    }
-    if (func_f_param){
-      func_f_param->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    b_type->Semantic_Analysis();
-    if(bracket){
-      bracket->Semantic_Analysis();
-    }
-    if (func_f_param){
-      func_f_param->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, b_type);
+    Take_Child(out, bracket);
+    Take_Child(out, func_f_param);
   }
 };
 
 // Block ::= '{' { BlockItem } '}'
 class BlockAST : public BaseAST{
   public:
+    BlockAST() : BaseAST(ASTKind::Block) {}
     std::unique_ptr<BaseAST> blockitem;
-
-  void Dump() const override {
-    blockitem->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "BlockAST {" << std::endl;
-    blockitem->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    current_func_symbol_table->depth++;
-    SymbolMap m;
-    current_func_symbol_table->symbol_maps.push_back(m);
-    blockitem->Semantic_Analysis();
-    current_func_symbol_table->symbol_maps.pop_back();
-    current_func_symbol_table->depth--;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {blockitem.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, blockitem);
   }
 };
 
 // BlockItem ::= Decl | Stmt
+// 一个 Block 只有一个 BlockItemAST, items 依次是里面的每个 Decl / Stmt
 class BlockItemAST : public BaseAST{
   public:
-    std::unique_ptr<BaseAST> decl;
-    std::unique_ptr<BaseAST> stmt;
-    std::unique_ptr<BaseAST> block_item;
-  void Dump() const override {
-    if (decl){
-      decl->Dump();
-    }
-    if (stmt){
-      stmt->Dump();
-    }
-    if (block_item){
-      block_item->Dump();
-    }
+    BlockItemAST() : BaseAST(ASTKind::BlockItem) {}
+    ASTList items;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, items);
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "BlockItemAST {" << std::endl;
-    if (decl){
-      decl->Print_AST();
-    }
-    if (stmt){
-      stmt->Print_AST();
-    }
-    if (block_item){
-      block_item->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (decl){
-      decl->Semantic_Analysis();
-    }
-    if (stmt){
-      stmt->Semantic_Analysis();
-    }
-    if (block_item){
-      block_item->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, items);
   }
 };
 
-/* Stmt ::= LVal '=' Exp ';' 
-          | [Exp] ';' 
-          | Block 
+/* Stmt ::= LVal '=' Exp ';'
+          | [Exp] ';'
+          | Block
           | "return" [Exp] ';'
-          | "if" '(' Exp ')' Stmt [ "else" Stmt ] 
+          | "if" '(' Exp ')' Stmt [ "else" Stmt ]
           | "while" '(' Exp ')' Stmt
           | "break" ';'
           | "continue" ';'
 */
 class StmtAST : public BaseAST{
   public:
+    StmtAST() : BaseAST(ASTKind::Stmt) {}
     std::unique_ptr<BaseAST> exp;
     std::unique_ptr<BaseAST> l_val;
     std::unique_ptr<BaseAST> block;
     std::unique_ptr<BaseAST> stmt_1;
     std::unique_ptr<BaseAST> stmt_2;
-    std::string symbol;
-  void Dump() const override {
-    if (symbol == "if"){
-      if(stmt_2){
-        exp->Dump();
-        stmt_1->Dump();
-        stmt_2->Dump();
-      }else {
-        exp->Dump();
-        stmt_1->Dump();
-      }
-    }else if (symbol == "while"){
-      exp->Dump();
-      stmt_1->Dump();
-    }else if (symbol == "return"){
-      if (exp){
-        exp->Dump();
-      }
-    }else if (symbol == "break"){
-     
-    }else if (symbol == "continue"){
-     
-    }else if (l_val && exp){
-      l_val->Dump();
-      exp->Dump();
-    }else if (block){
-      block->Dump();
-    }else if(exp){
-      exp->Dump();
-    }
-  }
-
-  void Print_AST() override{
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "StmtAST {" << std::endl;
-    if (symbol == "if"){
-      if(stmt_2){
-        exp->Print_AST();
-        stmt_1->Print_AST();
-        stmt_2->Print_AST();
-      }else {
-        exp->Print_AST();
-        stmt_1->Print_AST();
-      }
-    }else if (symbol == "while"){
-      exp->Print_AST();
-      stmt_1->Print_AST();
-    }else if (symbol == "return"){
-      if (exp){
-        exp->Print_AST();
-      }
-    }else if (symbol == "break"){
-    }else if (symbol == "continue"){
-    }else if (l_val && exp){
-      l_val->Print_AST();
-      exp->Print_AST();
-    }else if (block){
-      block->Print_AST();
-    }else if(exp){
-      exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (symbol == "if"){
-      if(stmt_2){
-        exp->Semantic_Analysis();
-        stmt_1->Semantic_Analysis();
-        stmt_2->Semantic_Analysis();
-      }else {
-        exp->Semantic_Analysis();
-        stmt_1->Semantic_Analysis();
-      }
-    }else if (symbol == "while"){
-      exp->Semantic_Analysis();
-      stmt_1->Semantic_Analysis();
-    }else if (symbol == "return"){
-      if (exp){
-        exp->Semantic_Analysis();
-      }
-    }else if (symbol == "break"){
-    }else if (symbol == "continue"){
-    }else if (l_val && exp){
-      l_val->Semantic_Analysis();
-      exp->Semantic_Analysis();
-    }else if (block){
-      block->Semantic_Analysis();
-    }else if(exp){
-      exp->Semantic_Analysis();
-    }
+    StmtKind stmt_kind = StmtKind::Empty;
+  // 各种语句的孩子都按源码顺序排列
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {l_val.get(), exp.get(), block.get(), stmt_1.get(), stmt_2.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, exp);
+    Take_Child(out, l_val);
+    Take_Child(out, block);
+    Take_Child(out, stmt_1);
+    Take_Child(out, stmt_2);
   }
 };
 
 // Exp ::= LOrExp
-// Exp ::= LOrExp [ Exp ]
 class ExpAST : public BaseAST{
   public:
+    ExpAST() : BaseAST(ASTKind::Exp) {}
     std::unique_ptr<BaseAST> l_or_exp;
-    std::unique_ptr<BaseAST> exp;
-  void Dump() const override {
-    if (l_or_exp){
-      l_or_exp->Dump();
-    }
-    if (exp){
-      exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {l_or_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "ExpAST {" << std::endl;
-    if (l_or_exp){
-      l_or_exp->Print_AST();
-    }
-    if (exp){
-      exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (l_or_exp){
-      l_or_exp->Semantic_Analysis();
-    }
-    if (exp){
-      exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, l_or_exp);
   }
 };
 
@@ -999,461 +638,828 @@ class ExpAST : public BaseAST{
 // LVal ::= IDENT [ Bracket ]
 class LValAST : public BaseAST{
   public:
-    std::string ident;
+    LValAST() : BaseAST(ASTKind::LVal) {}
+    Sym ident = kNoSym;
     std::unique_ptr<BaseAST> bracket;
     std::unique_ptr<BaseAST> exp;
-  void Dump() const override {
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "LValAST { " << std::endl;
-    std::cout << "IDENT: " << ident << std::endl;
-    identDepth ++;
-    if (exp){
-      exp->Print_AST();
-    }
-    if(bracket){
-      bracket->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    // undefinition
-    if (current_func_symbol_table){
-      // for i int vector symbol_map
-      if (current_func_symbol_table->symbol_maps[1].find(ident) == current_func_symbol_table->symbol_maps[1].end()
-          && symbol_table.symbol_map.find(ident) == symbol_table.symbol_map.end()){
-        // use func as var
-        if (symbol_table.func_symbol_map.find(ident) != symbol_table.func_symbol_map.end()){
-          std::cout << "Error: type C use func as var: " << ident << " at line: " << yylineno << "." << std::endl;
-          exit(1);
-        }    
-        std::cout << "Error: type A undefined variable " << ident << " at line: " << yylineno << "." << std::endl;
-        exit(1);
-      }else {
-        return;
-      }
-    }else if(symbol_table.symbol_map.find(ident) == symbol_table.symbol_map.end()){
-      std::cout << "Error: type A undefined global variable " << ident << " at line: " << yylineno << "." << std::endl;
-      exit(1);
-    }
-
-    if (exp){
-      exp->Semantic_Analysis();
-    }
-    if(bracket){
-      bracket->Semantic_Analysis();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {exp.get(), bracket.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, bracket);
+    Take_Child(out, exp);
+  }
+  // 变量或数组元素的地址, left 返回还剩几维没有下标
+  // 每个下标算完紧接着取一次地址, 所以下标不作为孩子遍历, 而是逐个单独 Dump_Exp
+  Value Dump_Address(int &left) const {
+    Symbol *symbol = ctx->koopa.symbols.Lookup(ident);
+    if (symbol->type == KOOPA_CONST){
+      ctx->Diag() << "Error: assignment to constant " << ctx->interner.Str(ident) << "." << std::endl;
+      ctx->Fail(1);
+    }
+    const VarInfo &info = ctx->koopa.vars[symbol->value];
+    Value ptr = info.addr;
+    // 数组形参的第一维用 getptr, 之后都是 getelemptr
+    bool is_pointer = info.is_pointer;
+    left = (int) info.dims.size() + (is_pointer ? 1 : 0);
+    const BaseAST *index = exp.get();
+    const BracketAST *next = (const BracketAST *) bracket.get();
+    while (index){
+      ptr = ctx->koopa.Get_Ptr(ptr, index->Dump_Exp(), !is_pointer);
+      is_pointer = false;
+      left --;
+      index = next ? next->const_exp.get() : NULL;
+      next = next ? (const BracketAST *) next->bracket.get() : NULL;
+    }
+    return ptr;
   }
 };
 
 // PrimaryExp ::= "(" Exp ")" | Number | LVal;
 class PrimaryExpAST : public BaseAST{
   public:
+    PrimaryExpAST() : BaseAST(ASTKind::PrimaryExp) {}
     std::unique_ptr<BaseAST> exp;
     std::unique_ptr<BaseAST> number;
     std::unique_ptr<BaseAST> l_val;
-  void Dump() const override {
-    if (exp){
-      exp->Dump();
-    }
-    if (number){
-      number->Dump();
-    }
-    if (l_val) {
-      l_val->Dump();
-    }
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "PrimaryExpAST {" << std::endl;
-    if (exp){
-      exp->Print_AST();
-    }
-    if (number){
-      number->Print_AST();
-    }
-    if (l_val) {
-      l_val->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+  // 只有一个孩子, 它的值就是自己的值
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {exp.get(), number.get(), l_val.get()});
   }
-  void Semantic_Analysis() override{
-    if (exp){
-      exp->Semantic_Analysis();
-    }
-    if (number){
-      number->Semantic_Analysis();
-    }
-    if (l_val) {
-      l_val->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, exp);
+    Take_Child(out, number);
+    Take_Child(out, l_val);
   }
 };
 
 // Number ::= INT_CONST;
 class NumberAST : public BaseAST{
   public:
-    std::string number;
-  void Dump() const override {
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    std::cout << "INT_CONST: " << number << std::endl;
-  }
+    NumberAST() : BaseAST(ASTKind::Number) {}
+    int number = 0;
 };
 
-/* UnaryExp ::= PrimaryExp 
-              | UnaryOp UnaryExp 
+/* UnaryExp ::= PrimaryExp
+              | UnaryOp UnaryExp
               | IDENT '(' [FuncRParams] ')'
 */
 class UnaryExpAST : public BaseAST{
   public:
+    UnaryExpAST() : BaseAST(ASTKind::UnaryExp) {}
     std::unique_ptr<BaseAST> primary_exp;
-    std::string unary_op;
-    std::string ident;
+    OpKind unary_op = OpKind::None;
+    Sym ident = kNoSym;
     std::unique_ptr<BaseAST> unary_exp;
     std::unique_ptr<BaseAST> func_r_params;
-  void Dump() const override {
-    if (primary_exp){
-      primary_exp->Dump();
-    }
-    if (unary_exp){
-      unary_exp->Dump();
-    }
-    if (func_r_params) {
-      func_r_params->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {primary_exp.get(), unary_exp.get(), func_r_params.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "UnaryExpAST {" << std::endl;
-    if (primary_exp){
-      primary_exp->Print_AST();
-    }
-    if (unary_exp){
-      unary_exp->Print_AST();
-    }
-    if (ident != ""){
-      identDepth --;
-      std::cout << std::string(2*identDepth, ' ');
-      std::cout << "IDENT: " << ident << std::endl;
-      identDepth ++;
-    }
-    if (func_r_params) {
-      func_r_params->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override {
-    // undefiniton check
-    if (ident != ""){
-      if (symbol_table.func_symbol_map.find(ident) == symbol_table.func_symbol_map.end()){
-        // use var as func
-        if(current_func_symbol_table){
-          if (current_func_symbol_table->symbol_maps[1].find(ident) != current_func_symbol_table->symbol_maps[1].end()
-              || symbol_table.symbol_map.find(ident) != symbol_table.symbol_map.end()){
-            std::cout << "Error: type C use var as func: " << ident << " at line: " << yylineno << "." << std::endl;
-            exit(1);
-          }
-        }else {
-          if (symbol_table.symbol_map.find(ident) != symbol_table.symbol_map.end()){
-            std::cout << "Error: type C use var as func: " << ident << " at line: " << yylineno << "." << std::endl;
-            exit(1);
-          }
-        }
-        
-        std::cout << "Error: type A undefiniton of function " << ident << " at line: " << yylineno << "." << std::endl;
-        exit(1);
-      }    
-    }
-    if (primary_exp){
-      primary_exp->Semantic_Analysis();
-    }
-    if (unary_exp){
-      unary_exp->Semantic_Analysis();
-    }
-    if (func_r_params) {
-      func_r_params->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, primary_exp);
+    Take_Child(out, unary_exp);
+    Take_Child(out, func_r_params);
   }
 };
 
 // UnaryOp ::= '+' | '-' | '!' ;
 class UnaryOpAST : public BaseAST{
   public:
-    std::string unary_op;
-  void Print_AST() override {
-    std::cout << unary_op;
-  }
+    UnaryOpAST() : BaseAST(ASTKind::UnaryOp) {}
+    OpKind unary_op = OpKind::None;
 };
 
 // FuncRParams ::= Exp { ',' Exp }
+// FuncRParams ::= Exp [ ',' FuncRParams ]
 class FuncRParamsAST : public BaseAST{
   public:
+    FuncRParamsAST() : BaseAST(ASTKind::FuncRParams) {}
     std::unique_ptr<BaseAST> exp;
-  void Dump() const override {
-    exp->Dump();
-  }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "FuncRParamsAST {" << std::endl;
-    exp->Print_AST();
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
+    std::unique_ptr<BaseAST> func_r_params;
+  // 实参的值依次留在栈上, 由 UnaryExp 取走
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {exp.get(), func_r_params.get()});
   }
-  void Semantic_Analysis() override{
-    exp->Semantic_Analysis();
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, exp);
+    Take_Child(out, func_r_params);
   }
 };
 
 // MulExp ::= UnaryExp | MulExp ( '*' | '/' | '%' ) UnaryExp;
 class MulExpAST : public BaseAST{
   public:
+    MulExpAST() : BaseAST(ASTKind::MulExp) {}
     std::unique_ptr<BaseAST> mul_exp;
-    std::string mul_op;
+    OpKind mul_op = OpKind::None;
     std::unique_ptr<BaseAST> unary_exp;
-  void Dump() const override {
-    if (mul_exp){
-      mul_exp->Dump();
-      unary_exp->Dump();
-    }
-    else if(unary_exp){
-      unary_exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {mul_exp.get(), unary_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "MulExpAST {" << std::endl;
-    if (mul_exp){
-      mul_exp->Print_AST();
-      unary_exp->Print_AST();
-    }
-    else if(unary_exp){
-      unary_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (mul_exp){
-      mul_exp->Semantic_Analysis();
-      unary_exp->Semantic_Analysis();
-    }
-    else if(unary_exp){
-      unary_exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, mul_exp);
+    Take_Child(out, unary_exp);
   }
 };
 
 // AddExp ::= MulExp | AddExp ( '+' | '-') MulExp;
 class AddExpAST : public BaseAST{
   public:
+    AddExpAST() : BaseAST(ASTKind::AddExp) {}
     std::unique_ptr<BaseAST> add_exp;
-    std::string add_op;
+    OpKind add_op = OpKind::None;
     std::unique_ptr<BaseAST> mul_exp;
-  void Dump() const override {
-    if (add_exp){      
-        add_exp->Dump();
-        mul_exp->Dump();
-    }
-    else if (mul_exp){
-      mul_exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {add_exp.get(), mul_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "AddExpAST {" << std::endl;
-    if (add_exp){      
-        add_exp->Print_AST();
-        mul_exp->Print_AST();
-    }
-    else if (mul_exp){
-      mul_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (add_exp){
-      add_exp->Semantic_Analysis();
-      mul_exp->Semantic_Analysis();
-    }
-    else if (mul_exp){
-      mul_exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, add_exp);
+    Take_Child(out, mul_exp);
   }
 };
 
 // RelExp ::= AddExp | RelExp ( "<" | ">" | "<=" | ">=" ) AddExp;
 class RelExpAST : public BaseAST{
   public:
+    RelExpAST() : BaseAST(ASTKind::RelExp) {}
     std::unique_ptr<BaseAST> rel_exp;
-    std::string rel_op;
+    OpKind rel_op = OpKind::None;
     std::unique_ptr<BaseAST> add_exp;
-  void Dump() const override {
-    if (rel_exp){
-      rel_exp->Dump();
-      add_exp->Dump();
-    }
-    else if(add_exp){
-      add_exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {rel_exp.get(), add_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "RelExpAST {" << std::endl;
-    if (rel_exp){
-      rel_exp->Print_AST();
-      add_exp->Print_AST();
-    }
-    else if(add_exp){
-      add_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (rel_exp){
-      rel_exp->Semantic_Analysis();
-      add_exp->Semantic_Analysis();
-    }
-    else if(add_exp){
-      add_exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, rel_exp);
+    Take_Child(out, add_exp);
   }
 };
 
 // EqExp ::= RelExp | EqExp ( "==" | "!=" ) RelExp;
 class EqExpAST : public BaseAST{
   public:
+    EqExpAST() : BaseAST(ASTKind::EqExp) {}
     std::unique_ptr<BaseAST> eq_exp;
-    std::string eq_op;
+    OpKind eq_op = OpKind::None;
     std::unique_ptr<BaseAST> rel_exp;
-  void Dump() const override {
-    if (eq_exp){
-      eq_exp->Dump();
-      rel_exp->Dump();
-    }
-    else if(rel_exp){
-      rel_exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {eq_exp.get(), rel_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "EqExpAST {" << std::endl;
-    if (eq_exp){
-      eq_exp->Print_AST();
-      rel_exp->Print_AST();
-    }
-    else if(rel_exp){
-      rel_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (eq_exp){
-      eq_exp->Semantic_Analysis();
-      rel_exp->Semantic_Analysis();
-    }
-    else if(rel_exp){
-      rel_exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, eq_exp);
+    Take_Child(out, rel_exp);
   }
 };
 
+// && 和 || 的短路求值, is_and 区分两者, 左边的值已经在栈上
+// 右边之前: 左边不是常量时, 结果先存进一个临时的 alloc, 按左边的值跳过或者进入右边
+// 返回 false 表示左边是常量且已经决定了结果, 不用生成右边
+// labels 里记下标号编号, 左边是常量时记 kShortConst / kShortSkip
+enum { kShortConst = -1, kShortSkip = -2 };
+
+static bool Dump_Short_Circuit_Rhs(DumpState &s, bool is_and){
+  Value lhs = Pop_Value(s);
+  if (lhs.kind == Value::Imm){
+    // && 的左边为 0, || 的左边非 0
+    if ((lhs.num != 0) != is_and){
+      s.values.push_back(Imm_Value(is_and ? 0 : 1));
+      s.labels.push_back(kShortSkip);
+      return false;
+    }
+    s.labels.push_back(kShortConst);
+    return true;
+  }
+  Value result = ctx->koopa.Alloc(kNoSym, NULL, 0);
+  ctx->koopa.Store(Imm_Value(is_and ? 0 : 1), result);
+  int id = ctx->koopa.label_count++;
+  Label rhs_label = {is_and ? "and_rhs" : "or_rhs", id};
+  Label end_label = {is_and ? "and_end" : "or_end", id};
+  if (is_and){
+    ctx->koopa.Branch(lhs, rhs_label, end_label);
+  }else {
+    ctx->koopa.Branch(lhs, end_label, rhs_label);
+  }
+  ctx->koopa.Dump_Label(rhs_label);
+  s.values.push_back(result);
+  s.labels.push_back(id);
+  return true;
+}
+
+// 右边之后: 把右边的值转成 0 / 1, 左边不是常量时存进临时的 alloc 再读出来
+static void Dump_Short_Circuit_End(DumpState &s, bool is_and){
+  int id = s.labels.back();
+  s.labels.pop_back();
+  if (id == kShortSkip){
+    return;
+  }
+  Value rhs = ctx->koopa.To_Bool(Pop_Value(s));
+  if (id == kShortConst){
+    s.values.push_back(rhs);
+    return;
+  }
+  Value result = Pop_Value(s);
+  ctx->koopa.Store(rhs, result);
+  ctx->koopa.Dump_Label({is_and ? "and_end" : "or_end", id});
+  s.values.push_back(ctx->koopa.Load(result));
+}
+
 // LAndExp ::= EqExp | LAndExp "&&" EqExp;
 class LAndExpAST : public BaseAST{
   public:
+    LAndExpAST() : BaseAST(ASTKind::LAndExp) {}
     std::unique_ptr<BaseAST> l_and_exp;
-    std::string l_and_op;
+    OpKind l_and_op = OpKind::None;
     std::unique_ptr<BaseAST> eq_exp;
-  void Dump() const override {
-    if (l_and_exp){
-      l_and_exp->Dump();
-      eq_exp->Dump();
-    } else if(eq_exp){
-      eq_exp->Dump();
-    }
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {l_and_exp.get(), eq_exp.get()});
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "LAndExpAST {" << std::endl;
-    if (l_and_exp){
-      l_and_exp->Print_AST();
-      eq_exp->Print_AST();
-    } else if(eq_exp){
-      eq_exp->Print_AST();
-    }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }  
-  void Semantic_Analysis() override {
-    if (l_and_exp){
-      l_and_exp->Semantic_Analysis();
-      eq_exp->Semantic_Analysis();
-    } else if(eq_exp){
-      eq_exp->Semantic_Analysis();
-    }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, l_and_exp);
+    Take_Child(out, eq_exp);
   }
 };
 
 // LOrExp ::= LAndExp | LOrExp "||" LAndExp;
 class LOrExpAST : public BaseAST{
   public:
+    LOrExpAST() : BaseAST(ASTKind::LOrExp) {}
     std::unique_ptr<BaseAST> l_or_exp;
-    std::string l_or_op;
+    OpKind l_or_op = OpKind::None;
     std::unique_ptr<BaseAST> l_and_exp;
-  void Dump() const override {
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {l_or_exp.get(), l_and_exp.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, l_or_exp);
+    Take_Child(out, l_and_exp);
+  }
+};
+
+// 折叠的表达式 (Compilation::collapse_exp 时由 sysy.y 生成), 代替 Exp 到 PrimaryExp 的整条单孩子链
+// 一种结点表示三种形状: 整数常量 (没有 lhs), 一元运算 (只有 lhs), 二元运算
+// 括号和一元 '+' 不建结点, 变量和函数调用仍然是 LValAST / UnaryExpAST
+class ExprAST : public BaseAST{
+  public:
+    ExprAST() : BaseAST(ASTKind::Expr) {}
+    OpKind op = OpKind::None;
+    int number = 0;
+    std::unique_ptr<BaseAST> lhs;
+    std::unique_ptr<BaseAST> rhs;
+  const BaseAST *Child(uint32_t i) const override {
+    return Nth_Child(i, {lhs.get(), rhs.get()});
+  }
+  void Take_Children(std::vector<BaseAST *> &out) override {
+    Take_Child(out, lhs);
+    Take_Child(out, rhs);
+  }
+  bool Is_Short_Circuit() const {
+    return op == OpKind::And || op == OpKind::Or;
+  }
+};
+
+// 下面是生成 Koopa IR 时要用到后面定义的结点类型的部分
+
+// Bracket 链上每一维的长度
+static std::vector<int> Array_Dims(const BaseAST *bracket){
+  std::vector<int> dims;
+  for (auto b = (const BracketAST *) bracket; b; b = (const BracketAST *) b->bracket.get()){
+    dims.push_back(b->const_exp->Eval());
+  }
+  return dims;
+}
+
+// InitVal 和 ConstInitVal 长得一样, 只是成员名字不同
+static const BaseAST *Init_Exp(const BaseAST *init){
+  if (init->kind == ASTKind::InitVal){
+    return ((const InitValAST *) init)->exp.get();
+  }
+  return ((const ConstInitValAST *) init)->const_exp.get();
+}
+
+static const BraceAST *Init_Brace(const BaseAST *init){
+  if (init->kind == ASTKind::InitVal){
+    return (const BraceAST *) ((const InitValAST *) init)->brace.get();
+  }
+  return (const BraceAST *) ((const ConstInitValAST *) init)->brace.get();
+}
+
+// 按 SysY 的规则展开初始化列表, elems 里没有给出初值的位置保持 NULL (即 0)
+// strides[k] 是第 k 维及之后的元素个数, 一个子列表 {...} 对齐到能整除当前位置的最大的那一维
+static void Flatten_Init(const BaseAST *init, const std::vector<size_t> &strides, int level, size_t begin, std::vector<const BaseAST *> &elems){
+  int n = (int) strides.size() - 1;
+  size_t pos = begin;
+  size_t end = begin + strides[level];
+  const BraceAST *brace = Init_Brace(init);
+  for (size_t i = 0; brace && i < brace->items.size() && pos < end; i++){
+    const BaseAST *item = brace->items[i].get();
+    const BaseAST *exp = Init_Exp(item);
+    if (exp){
+      elems[pos++] = exp;
+      continue;
+    }
+    if (level == n){
+      continue;
+    }
+    int k = level + 1;
+    while (k < n && (pos - begin) % strides[k] != 0){
+      k ++;
+    }
+    Flatten_Init(item, strides, k, pos, elems);
+    pos += strides[k];
+  }
+}
+
+// 定义变量 (包括常量数组), init 是 InitVal / ConstInitVal, 可以为空
+static void Dump_Var_Def(Sym ident, const BaseAST *bracket, const BaseAST *init){
+  std::vector<int> dims = Array_Dims(bracket);
+  int n = (int) dims.size();
+  std::vector<const BaseAST *> elems;
+  std::vector<size_t> strides(n + 1, 1);
+  if (n && init){
+    for (int k = n - 1; k >= 0; k--){
+      strides[k] = strides[k + 1] * dims[k];
+    }
+    elems.assign(strides[0], NULL);
+    Flatten_Init(init, strides, 0, 0, elems);
+  }
+
+  if (!ctx->koopa.in_function){
+    // 全局变量的初值必须是常量, 全 0 时用 zeroinit
+    std::vector<int> values;
+    if (n == 0 && init){
+      values.push_back(init->Eval());
+    }
+    for (const BaseAST *elem : elems){
+      values.push_back(elem ? elem->Eval() : 0);
+    }
+    bool all_zero = true;
+    for (int v : values){
+      all_zero = all_zero && v == 0;
+    }
+    Value addr = ctx->koopa.Global_Alloc(ident, dims.data(), n, all_zero ? NULL : values.data());
+    ctx->koopa.Declare_Var(ident, addr, false, dims.data(), n);
+    return;
+  }
+
+  Value addr = ctx->koopa.Alloc(ident, dims.data(), n);
+  ctx->koopa.Declare_Var(ident, addr, false, dims.data(), n);
+  if (!init){
+    return;
+  }
+  if (n == 0){
+    const BaseAST *exp = Init_Exp(init);
+    ctx->koopa.Store(exp ? exp->Dump_Exp() : Imm_Value(0), addr);
+    return;
+  }
+  // 局部数组逐个元素赋值, 没给出的补 0
+  for (size_t i = 0; i < elems.size(); i++){
+    Value v = elems[i] ? elems[i]->Dump_Exp() : Imm_Value(0);
+    Value ptr = addr;
+    for (int k = 0; k < n; k++){
+      ptr = ctx->koopa.Get_Ptr(ptr, Imm_Value((int) (i / strides[k + 1] % dims[k])), true);
+    }
+    ctx->koopa.Store(v, ptr);
+  }
+}
+
+#include "ASTVisitor.h"
+
+// 生成 Koopa IR, 用 ASTVisitor 编译期分派, 只处理下面这几种结点
+// 表达式的值和还没处理完的标号在 s 里, 每次 Dump / Dump_Exp 各有一份
+class DumpPass : public ASTVisitor<DumpPass> {
+ public:
+  DumpState s;
+
+  void Enter(const CompUnitAST *) {
+    ctx->koopa.Dump_Decls();
+  }
+
+  void Enter(const FuncDefOrVarDeclAST *node) {
+    node->Set_Func_Type();
+  }
+
+  void Enter(const FuncDefAST_ *node) {
+    std::vector<FuncParam> params;
+    const BaseAST *p = node->func_f_params ? ((const FuncFParamsAST *) node->func_f_params.get())->func_f_param.get() : NULL;
+    for (; p; p = ((const FuncFParamAST *) p)->func_f_param.get()){
+      auto param = (const FuncFParamAST *) p;
+      params.push_back({param->ident, param->is_array, Array_Dims(param->bracket.get()), {}});
+    }
+    ctx->koopa.Begin_Function(node->ident, node->func_type == "void", params);
+
+    // 形参单独一层作用域, 标量形参复制到 alloc 里, 数组形参直接当指针用
+    ctx->koopa.symbols.PushScope();
+    for (const FuncParam &param : params){
+      if (param.is_pointer){
+        ctx->koopa.Declare_Var(param.ident, param.value, true, param.dims.data(), (int) param.dims.size());
+      }else {
+        Value addr = ctx->koopa.Alloc(param.ident, NULL, 0);
+        ctx->koopa.Store(param.value, addr);
+        ctx->koopa.Declare_Var(param.ident, addr, false, NULL, 0);
+      }
+    }
+  }
+  // 形参在 Enter 里生成
+  bool Enter_Child(const FuncDefAST_ *node, const BaseAST *child) {
+    return child == node->block.get();
+  }
+  void Leave(const FuncDefAST_ *) {
+    ctx->koopa.symbols.PopScope();
+    ctx->koopa.End_Function();
+  }
+
+  // 长度和初值在 Leave 里求值和展开
+  bool Enter_Child(const ConstDefAST *, const BaseAST *) {
+    return false;
+  }
+  void Leave(const ConstDefAST *node) {
+    if (node->bracket){
+      // 常量数组和变量一样分配空间
+      Dump_Var_Def(node->ident, node->bracket.get(), node->const_init_val.get());
+    }else {
+      ctx->koopa.Declare_Const(node->ident, node->const_init_val->Eval());
+    }
+  }
+
+  bool Enter_Child(const VarDefAST *, const BaseAST *) {
+    return false;
+  }
+  void Leave(const VarDefAST *node) {
+    Dump_Var_Def(node->ident, node->bracket.get(), node->init_val.get());
+  }
+
+  void Enter(const BlockAST *) {
+    ctx->koopa.symbols.PushScope();
+  }
+  void Leave(const BlockAST *) {
+    ctx->koopa.symbols.PopScope();
+  }
+
+  // while 的标号在条件之前就要输出, if 的标号在条件算完之后才分配
+  void Enter(const StmtAST *node) {
+    if (node->stmt_kind == StmtKind::While){
+      int id = ctx->koopa.label_count++;
+      s.labels.push_back(id);
+      ctx->koopa.Dump_Label({"while_entry", id});
+    }
+  }
+  bool Enter_Child(const StmtAST *node, const BaseAST *child) {
+    switch (node->stmt_kind){
+      case StmtKind::Assign:
+        // 先算右边的值, 左边的地址最后在 Leave 里算
+        return child != node->l_val.get();
+      case StmtKind::If:
+        if (child == node->stmt_1.get()){
+          Value cond = Pop_Value(s);
+          int id = ctx->koopa.label_count++;
+          s.labels.push_back(id);
+          Label then_label = {"then", id};
+          Label else_label = {"else", id};
+          Label end_label = {"end", id};
+          ctx->koopa.Branch(cond, then_label, node->stmt_2 ? else_label : end_label);
+          ctx->koopa.Dump_Label(then_label);
+        }else if (child == node->stmt_2.get()){
+          int id = s.labels.back();
+          if (!ctx->koopa.block_closed){
+            ctx->koopa.Jump({"end", id});
+          }
+          ctx->koopa.Dump_Label({"else", id});
+        }
+        return true;
+      case StmtKind::While:
+        if (child == node->stmt_1.get()){
+          int id = s.labels.back();
+          Value cond = Pop_Value(s);
+          Label body_label = {"while_body", id};
+          ctx->koopa.Branch(cond, body_label, {"while_end", id});
+          ctx->koopa.Dump_Label(body_label);
+          ctx->koopa.loop_stack.push_back({{"while_entry", id}, {"while_end", id}});
+        }
+        return true;
+      default:
+        return true;
+    }
+  }
+  void Leave(const StmtAST *node) {
+    switch (node->stmt_kind){
+      case StmtKind::Exp:
+        if (node->exp){
+          Pop_Value(s);
+        }
+        break;
+      case StmtKind::Assign: {
+        Value v = Pop_Value(s);
+        int left;
+        Value addr = ((const LValAST *) node->l_val.get())->Dump_Address(left);
+        ctx->koopa.Store(v, addr);
+        break;
+      }
+      case StmtKind::Return:
+        if (node->exp){
+          Value v = Pop_Value(s);
+          ctx->koopa.Return(&v);
+        }else {
+          ctx->koopa.Return(NULL);
+        }
+        break;
+      case StmtKind::If: {
+        int id = s.labels.back();
+        s.labels.pop_back();
+        ctx->koopa.Dump_Label({"end", id});
+        break;
+      }
+      case StmtKind::While: {
+        int id = s.labels.back();
+        s.labels.pop_back();
+        ctx->koopa.loop_stack.pop_back();
+        if (!ctx->koopa.block_closed){
+          ctx->koopa.Jump({"while_entry", id});
+        }
+        ctx->koopa.Dump_Label({"while_end", id});
+        break;
+      }
+      // 循环外的 break / continue 已经被语义分析拒绝
+      case StmtKind::Break:
+        assert(!ctx->koopa.loop_stack.empty());
+        ctx->koopa.Jump(ctx->koopa.loop_stack.back().second);
+        break;
+      case StmtKind::Continue:
+        assert(!ctx->koopa.loop_stack.empty());
+        ctx->koopa.Jump(ctx->koopa.loop_stack.back().first);
+        break;
+      case StmtKind::Block:
+      case StmtKind::Empty:
+        break;
+    }
+  }
+
+  // 下标由 Dump_Address 逐个生成, 不作为孩子遍历
+  bool Enter_Child(const LValAST *, const BaseAST *) {
+    return false;
+  }
+  void Leave(const LValAST *node) {
+    Symbol *symbol = ctx->koopa.symbols.Lookup(node->ident);
+    if (symbol->type == KOOPA_CONST){
+      s.values.push_back(Imm_Value(symbol->value));
+      return;
+    }
+    bool is_pointer = ctx->koopa.vars[symbol->value].is_pointer;
+    int left;
+    Value ptr = node->Dump_Address(left);
+    if (left == 0){
+      s.values.push_back(ctx->koopa.Load(ptr));
+    }else if (is_pointer && !node->exp){
+      // 数组作实参, 退化成指向第一个元素的指针
+      s.values.push_back(ptr);
+    }else {
+      s.values.push_back(ctx->koopa.Get_Ptr(ptr, Imm_Value(0), true));
+    }
+  }
+
+  void Leave(const NumberAST *node) {
+    s.values.push_back(Imm_Value(node->number));
+  }
+
+  // 函数调用时实参的值依次在栈上, 要数实参的个数
+  void Leave(const UnaryExpAST *node) {
+    if (node->primary_exp){
+      return;
+    }
+    if (node->unary_exp){
+      Value v = Pop_Value(s);
+      switch (node->unary_op){
+        case OpKind::Sub:
+          v = ctx->koopa.Binary(OpKind::Sub, Imm_Value(0), v);
+          break;
+        case OpKind::Not:
+          v = ctx->koopa.Binary(OpKind::Eq, v, Imm_Value(0));
+          break;
+        default:
+          break;
+      }
+      s.values.push_back(v);
+      return;
+    }
+    size_t n = 0;
+    for (auto p = (const FuncRParamsAST *) node->func_r_params.get(); p; p = (const FuncRParamsAST *) p->func_r_params.get()){
+      n ++;
+    }
+    std::vector<Value> args(s.values.end() - n, s.values.end());
+    s.values.resize(s.values.size() - n);
+    s.values.push_back(ctx->koopa.Call(node->ident, args));
+  }
+
+  void Leave(const MulExpAST *node) {
+    if (node->mul_exp){
+      Dump_Binary(s, node->mul_op);
+    }
+  }
+  void Leave(const AddExpAST *node) {
+    if (node->add_exp){
+      Dump_Binary(s, node->add_op);
+    }
+  }
+  void Leave(const RelExpAST *node) {
+    if (node->rel_exp){
+      Dump_Binary(s, node->rel_op);
+    }
+  }
+  void Leave(const EqExpAST *node) {
+    if (node->eq_exp){
+      Dump_Binary(s, node->eq_op);
+    }
+  }
+
+  // 短路求值: 左边为 0 时不计算右边
+  bool Enter_Child(const LAndExpAST *node, const BaseAST *child) {
+    if (node->l_and_exp && child == node->eq_exp.get()){
+      return Dump_Short_Circuit_Rhs(s, true);
+    }
+    return true;
+  }
+  void Leave(const LAndExpAST *node) {
+    if (node->l_and_exp){
+      Dump_Short_Circuit_End(s, true);
+    }
+  }
+
+  // 短路求值: 左边非 0 时不计算右边
+  bool Enter_Child(const LOrExpAST *node, const BaseAST *child) {
+    if (node->l_or_exp && child == node->l_and_exp.get()){
+      return Dump_Short_Circuit_Rhs(s, false);
+    }
+    return true;
+  }
+  void Leave(const LOrExpAST *node) {
+    if (node->l_or_exp){
+      Dump_Short_Circuit_End(s, false);
+    }
+  }
+
+  bool Enter_Child(const ExprAST *node, const BaseAST *child) {
+    if (node->Is_Short_Circuit() && child == node->rhs.get()){
+      return Dump_Short_Circuit_Rhs(s, node->op == OpKind::And);
+    }
+    return true;
+  }
+  void Leave(const ExprAST *node) {
+    if (!node->lhs){
+      s.values.push_back(Imm_Value(node->number));
+    }else if (!node->rhs){
+      Value v = Pop_Value(s);
+      if (node->op == OpKind::Sub){
+        s.values.push_back(ctx->koopa.Binary(OpKind::Sub, Imm_Value(0), v));
+      }else {
+        s.values.push_back(ctx->koopa.Binary(OpKind::Eq, v, Imm_Value(0)));
+      }
+    }else if (node->Is_Short_Circuit()){
+      Dump_Short_Circuit_End(s, node->op == OpKind::And);
+    }else {
+      Dump_Binary(s, node->op);
+    }
+  }
+};
+
+// 常量表达式求值, 孩子的值在 values 栈上, 和 DumpState::values 一样
+class EvalPass : public ASTVisitor<EvalPass> {
+ public:
+  std::vector<int> values;
+
+  // 花括号的值是 0
+  bool Enter_Child(const ConstInitValAST *node, const BaseAST *child) {
+    return child == node->const_exp.get();
+  }
+  void Leave(const ConstInitValAST *node) {
+    if (!node->const_exp){
+      values.push_back(0);
+    }
+  }
+  bool Enter_Child(const InitValAST *node, const BaseAST *child) {
+    return child == node->exp.get();
+  }
+  void Leave(const InitValAST *node) {
+    if (!node->exp){
+      values.push_back(0);
+    }
+  }
+
+  bool Enter_Child(const LValAST *, const BaseAST *) {
+    return false;
+  }
+  void Leave(const LValAST *node) {
+    Symbol *symbol = ctx->koopa.symbols.Lookup(node->ident);
+    if (symbol == NULL || symbol->type != KOOPA_CONST || node->exp){
+      ctx->Diag() << "Error: " << ctx->interner.Str(node->ident) << " is not a constant." << std::endl;
+      ctx->Fail(1);
+    }
+    values.push_back(symbol->value);
+  }
 
-    if (l_or_exp){
-      l_or_exp->Dump();
-      l_and_exp->Dump();
-    } else if(l_and_exp){
-      l_and_exp->Dump();
+  void Leave(const NumberAST *node) {
+    values.push_back(node->number);
+  }
+
+  // 函数调用不是常量, 不用看实参
+  bool Enter_Child(const UnaryExpAST *node, const BaseAST *) {
+    return node->ident == kNoSym;
+  }
+  void Leave(const UnaryExpAST *node) {
+    if (node->primary_exp){
+      return;
+    }
+    if (node->unary_exp){
+      int &v = values.back();
+      switch (node->unary_op){
+        case OpKind::Sub:
+          v = Eval_Binary(OpKind::Sub, 0, v);
+          break;
+        case OpKind::Not:
+          v = !v;
+          break;
+        default:
+          break;
+      }
+      return;
+    }
+    ctx->Diag() << "Error: call of " << ctx->interner.Str(node->ident) << " is not a constant." << std::endl;
+    ctx->Fail(1);
+  }
+
+  void Leave(const MulExpAST *node) {
+    if (node->mul_exp){
+      Eval_Binary(values, node->mul_op);
+    }
+  }
+  void Leave(const AddExpAST *node) {
+    if (node->add_exp){
+      Eval_Binary(values, node->add_op);
+    }
+  }
+  void Leave(const RelExpAST *node) {
+    if (node->rel_exp){
+      Eval_Binary(values, node->rel_op);
     }
   }
-  void Print_AST() override {
-    std::cout << std::string(2*identDepth, ' ');
-    identDepth ++;
-    std::cout << "LOrExpAST {" << std::endl;
-    if (l_or_exp){
-      l_or_exp->Print_AST();
-      l_and_exp->Print_AST();
-    } else if(l_and_exp){
-      l_and_exp->Print_AST();
+  void Leave(const EqExpAST *node) {
+    if (node->eq_exp){
+      Eval_Binary(values, node->eq_op);
     }
-    identDepth --;
-    std::cout << std::string(2*identDepth, ' ');
-		std::cout << "}" << std::endl;
-  }
-  void Semantic_Analysis() override{
-    if (l_or_exp){
-      l_or_exp->Semantic_Analysis();
-      l_and_exp->Semantic_Analysis();
-    } else if(l_and_exp){
-      l_and_exp->Semantic_Analysis();
+  }
+  void Leave(const LAndExpAST *node) {
+    if (node->l_and_exp){
+      Eval_Binary(values, node->l_and_op);
+    }
+  }
+  void Leave(const LOrExpAST *node) {
+    if (node->l_or_exp){
+      Eval_Binary(values, node->l_or_op);
+    }
+  }
+
+  void Leave(const ExprAST *node) {
+    if (!node->lhs){
+      values.push_back(node->number);
+    }else if (!node->rhs){
+      int &v = values.back();
+      v = node->op == OpKind::Sub ? Eval_Binary(OpKind::Sub, 0, v) : !v;
+    }else {
+      Eval_Binary(values, node->op);
     }
   }
-};
\ No newline at end of file
+};
+
+inline void BaseAST::Dump() const {
+  DumpPass pass;
+  Walk_AST(this, pass);
+}
+
+inline Value BaseAST::Dump_Exp() const {
+  DumpPass pass;
+  Walk_AST(this, pass);
+  if (pass.s.values.empty()){
+    return {Value::None, 0, kNoSym, NULL};
+  }
+  return pass.s.values.back();
+}
+
+inline int BaseAST::Eval() const {
+  EvalPass pass;
+  Walk_AST(this, pass);
+  return pass.values.empty() ? 0 : pass.values.back();
+}
+
+// 拆掉一棵树: 每个结点先交出孩子再析构, 析构时已经没有孩子, 不会递归
+// 结点的内存归 arena, 这里只是调用析构函数
+inline void Destroy_AST(BaseAST *root){
+  std::vector<BaseAST *> stack;
+  stack.push_back(root);
+  while (!stack.empty()){
+    BaseAST *node = stack.back();
+    stack.pop_back();
+    node->Take_Children(stack);
+    delete node;
+  }
+}
+
+inline void std::default_delete<BaseAST>::operator()(BaseAST *node) const {
+  Destroy_AST(node);
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AST.h"
+#include "Compilation.h"
+#include "Location.h"
+#include "OutputBuffer.h"
+
+// 机器可读的 AST 导出: -ast-json (每行一个结点的 JSON) 和 -ast-dot (Graphviz)
+// 两者都由 Export_AST 驱动, 边遍历边写进 OutputBuffer, 不在内存里先搭一棵文档树
+
+// 按前序遍历整棵 AST, 由 ASTWalk.h 的 Walk_AST 驱动, 不受树深度限制
+// 结点按访问顺序从 0 编号, 每个结点依次调用
+//   writer.Enter(node, id, parent)   parent 是父结点编号, 根结点为 UINT32_MAX
+//   writer.Leave(node, id)           整棵子树访问完之后
+// 孩子的顺序和 FlatAST 一致
+template <typename Writer>
+struct ASTExportVisitor {
+  Writer &writer;
+  uint32_t next;
+  // 已经 Enter 但还没 Leave 的结点编号
+  std::vector<uint32_t> open;
+
+  void Pre(const BaseAST *node) {
+    uint32_t id = next++;
+    writer.Enter(node, id, open.empty() ? UINT32_MAX : open.back());
+    open.push_back(id);
+  }
+  bool Before(const BaseAST *, const BaseAST *) {
+    return true;
+  }
+  void Post(const BaseAST *node) {
+    writer.Leave(node, open.back());
+    open.pop_back();
+  }
+};
+
+template <typename Writer>
+void Export_AST(const BaseAST *root, Writer &writer) {
+  ASTExportVisitor<Writer> visitor = {writer, 0, {}};
+  Walk_AST(root, visitor);
+}
+
+// 结点自带的属性, 没有的字段为 NULL
+typedef struct{
+  const char *ident;
+  const char *op;
+  const char *stmt;
+  const char *type;
+  bool has_value;
+  int value;
+} ASTNodeAttrs;
+
+static const char *AST_Kind_Name(ASTKind k) {
+  static const char *names[] = {
+    "CompUnit", "CompUnits", "FuncDef_", "BType", "FuncDefOrVarDecl", "Decl", "ConstDecl", "ConstDef",
+    "Bracket", "ConstInitVal", "Brace", "ConstExp", "VarDecl", "VarDecl_", "VarDef", "InitVal",
+    "FuncDef", "FuncType", "FuncFParams", "FuncFParam", "Block", "BlockItem", "Stmt", "Exp",
+    "LVal", "PrimaryExp", "Number", "UnaryExp", "UnaryOp", "FuncRParams", "MulExp", "AddExp",
+    "RelExp", "EqExp", "LAndExp", "LOrExp", "Expr",
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == (size_t) ASTKind::Expr + 1, "ASTKind names out of sync");
+  return names[(int) k];
+}
+
+// 运算符的源码写法
+static const char *AST_Op_Text(OpKind op) {
+  static const char *names[] = {NULL, "+", "-", "!", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&&", "||"};
+  return names[(int) op];
+}
+
+static const char *AST_Stmt_Name(StmtKind k) {
+  static const char *names[] = {"empty", "exp", "assign", "block", "return", "if", "while", "break", "continue"};
+  return names[(int) k];
+}
+
+static ASTNodeAttrs AST_Node_Attrs(const BaseAST *node) {
+  ASTNodeAttrs a = {NULL, NULL, NULL, NULL, false, 0};
+  auto str = [](Sym ident) { return ident == kNoSym ? NULL : ctx->interner.Str(ident); };
+  auto text = [](const std::string &s) { return s.empty() ? NULL : s.c_str(); };
+  switch (node->kind){
+    case ASTKind::FuncDef_: {
+      auto n = (const FuncDefAST_ *) node;
+      a.ident = str(n->ident);
+      a.type = text(n->func_type);
+      break;
+    }
+    case ASTKind::BType: a.type = text(((const BTypeAST *) node)->type); break;
+    case ASTKind::FuncType: a.type = text(((const FuncTypeAST *) node)->type); break;
+    case ASTKind::ConstDef: a.ident = str(((const ConstDefAST *) node)->ident); break;
+    case ASTKind::VarDef: a.ident = str(((const VarDefAST *) node)->ident); break;
+    case ASTKind::FuncDef: a.ident = str(((const FuncDefAST *) node)->ident); break;
+    case ASTKind::FuncFParam: {
+      auto n = (const FuncFParamAST *) node;
+      a.ident = str(n->ident);
+      a.type = n->is_array ? "int[]" : "int";
+      break;
+    }
+    case ASTKind::LVal: a.ident = str(((const LValAST *) node)->ident); break;
+    case ASTKind::Number:
+      a.has_value = true;
+      a.value = ((const NumberAST *) node)->number;
+      break;
+    case ASTKind::UnaryExp: {
+      auto n = (const UnaryExpAST *) node;
+      a.ident = str(n->ident);
+      a.op = AST_Op_Text(n->unary_op);
+      break;
+    }
+    case ASTKind::UnaryOp: a.op = AST_Op_Text(((const UnaryOpAST *) node)->unary_op); break;
+    case ASTKind::Stmt: a.stmt = AST_Stmt_Name(((const StmtAST *) node)->stmt_kind); break;
+    case ASTKind::MulExp: a.op = AST_Op_Text(((const MulExpAST *) node)->mul_op); break;
+    case ASTKind::AddExp: a.op = AST_Op_Text(((const AddExpAST *) node)->add_op); break;
+    case ASTKind::RelExp: a.op = AST_Op_Text(((const RelExpAST *) node)->rel_op); break;
+    case ASTKind::EqExp: a.op = AST_Op_Text(((const EqExpAST *) node)->eq_op); break;
+    case ASTKind::LAndExp: a.op = AST_Op_Text(((const LAndExpAST *) node)->l_and_op); break;
+    case ASTKind::LOrExp: a.op = AST_Op_Text(((const LOrExpAST *) node)->l_or_op); break;
+    case ASTKind::Expr: {
+      auto n = (const ExprAST *) node;
+      a.op = AST_Op_Text(n->op);
+      a.has_value = !n->lhs;
+      a.value = n->number;
+      break;
+    }
+    default: break;
+  }
+  return a;
+}
+
+// -ast-json: 每个结点一行, 按前序输出, 父结点总在孩子之前
+// {"id":3,"parent":1,"kind":"FuncDef","line":1,"column":1,"ident":"main"}
+// 可选字段 ident / op / stmt / type / value 只在结点有这个属性时出现
+// 标识符只含字母数字下划线, 运算符和类型名也没有要转义的字符
+class ASTJsonWriter {
+ public:
+  explicit ASTJsonWriter(OutputBuffer &out) : out(out) {}
+
+  void Enter(const BaseAST *node, uint32_t id, uint32_t parent) {
+    SourcePos pos = ctx->source_map.Decode(node->loc);
+    out << "{\"id\":" << (int) id << ",\"parent\":" << (parent == UINT32_MAX ? -1 : (int) parent)
+        << ",\"kind\":\"" << AST_Kind_Name(node->kind)
+        << "\",\"line\":" << (int) pos.line << ",\"column\":" << (int) pos.column;
+    ASTNodeAttrs a = AST_Node_Attrs(node);
+    Field("ident", a.ident);
+    Field("op", a.op);
+    Field("stmt", a.stmt);
+    Field("type", a.type);
+    if (a.has_value){
+      out << ",\"value\":" << a.value;
+    }
+    out << "}\n";
+  }
+
+  void Leave(const BaseAST *, uint32_t) {}
+
+ private:
+  OutputBuffer &out;
+
+  void Field(const char *name, const char *value) {
+    if (value){
+      out << ",\"" << name << "\":\"" << value << '"';
+    }
+  }
+};
+
+// -ast-dot: 每个结点一个框, 标签是种类和属性, 父结点指向孩子
+class ASTDotWriter {
+ public:
+  explicit ASTDotWriter(OutputBuffer &out) : out(out) {
+    out << "digraph AST {\n  node [shape=box, fontname=monospace];\n";
+  }
+
+  void Enter(const BaseAST *node, uint32_t id, uint32_t parent) {
+    out << "  n" << (int) id << " [label=\"" << AST_Kind_Name(node->kind);
+    ASTNodeAttrs a = AST_Node_Attrs(node);
+    for (const char *s : {a.type, a.ident, a.stmt, a.op}){
+      if (s){
+        out << "\\n" << s;
+      }
+    }
+    if (a.has_value){
+      out << "\\n" << a.value;
+    }
+    out << "\"];\n";
+    if (parent != UINT32_MAX){
+      out << "  n" << (int) parent << " -> n" << (int) id << ";\n";
+    }
+  }
+
+  void Leave(const BaseAST *, uint32_t) {}
+
+  void Finish() {
+    out << "}\n";
+  }
+
+ private:
+  OutputBuffer &out;
+};
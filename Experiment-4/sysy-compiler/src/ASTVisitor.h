@@ -0,0 +1,109 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+// 由 AST.h 在所有结点类型定义之后引入, Visit_As 要用到完整的结点类型
+
+// 编译期分派的 AST 遍历
+// 结点种类是封闭的 (ASTKind), 按 kind 转成具体类型之后调用处理函数, 不经过虚函数,
+// 处理函数可以内联进遍历循环; 新增一个遍历只要写一个派生类, 不用改结点类
+
+// 按 node->kind 把 node 转成具体的结点类型, 调用 f(const XxxAST *)
+template <typename F>
+void Visit_As(const BaseAST *node, F &&f) {
+  switch (node->kind){
+    case ASTKind::CompUnit: f((const CompUnitAST *) node); break;
+    case ASTKind::CompUnits: f((const CompUnitsAST *) node); break;
+    case ASTKind::FuncDef_: f((const FuncDefAST_ *) node); break;
+    case ASTKind::BType: f((const BTypeAST *) node); break;
+    case ASTKind::FuncDefOrVarDecl: f((const FuncDefOrVarDeclAST *) node); break;
+    case ASTKind::Decl: f((const DeclAST *) node); break;
+    case ASTKind::ConstDecl: f((const ConstDeclAST *) node); break;
+    case ASTKind::ConstDef: f((const ConstDefAST *) node); break;
+    case ASTKind::Bracket: f((const BracketAST *) node); break;
+    case ASTKind::ConstInitVal: f((const ConstInitValAST *) node); break;
+    case ASTKind::Brace: f((const BraceAST *) node); break;
+    case ASTKind::ConstExp: f((const ConstExpAST *) node); break;
+    case ASTKind::VarDecl: f((const VarDeclAST *) node); break;
+    case ASTKind::VarDecl_: f((const VarDeclAST_ *) node); break;
+    case ASTKind::VarDef: f((const VarDefAST *) node); break;
+    case ASTKind::InitVal: f((const InitValAST *) node); break;
+    case ASTKind::FuncDef: f((const FuncDefAST *) node); break;
+    case ASTKind::FuncType: f((const FuncTypeAST *) node); break;
+    case ASTKind::FuncFParams: f((const FuncFParamsAST *) node); break;
+    case ASTKind::FuncFParam: f((const FuncFParamAST *) node); break;
+    case ASTKind::Block: f((const BlockAST *) node); break;
+    case ASTKind::BlockItem: f((const BlockItemAST *) node); break;
+    case ASTKind::Stmt: f((const StmtAST *) node); break;
+    case ASTKind::Exp: f((const ExpAST *) node); break;
+    case ASTKind::LVal: f((const LValAST *) node); break;
+    case ASTKind::PrimaryExp: f((const PrimaryExpAST *) node); break;
+    case ASTKind::Number: f((const NumberAST *) node); break;
+    case ASTKind::UnaryExp: f((const UnaryExpAST *) node); break;
+    case ASTKind::UnaryOp: f((const UnaryOpAST *) node); break;
+    case ASTKind::FuncRParams: f((const FuncRParamsAST *) node); break;
+    case ASTKind::MulExp: f((const MulExpAST *) node); break;
+    case ASTKind::AddExp: f((const AddExpAST *) node); break;
+    case ASTKind::RelExp: f((const RelExpAST *) node); break;
+    case ASTKind::EqExp: f((const EqExpAST *) node); break;
+    case ASTKind::LAndExp: f((const LAndExpAST *) node); break;
+    case ASTKind::LOrExp: f((const LOrExpAST *) node); break;
+    case ASTKind::Expr: f((const ExprAST *) node); break;
+  }
+}
+
+// 派生类 V 有没有接受 const T * 的处理函数
+template <typename V, typename T, typename = void>
+struct Has_Enter : std::false_type {};
+template <typename V, typename T>
+struct Has_Enter<V, T, std::void_t<decltype(std::declval<V &>().Enter(std::declval<T>()))>> : std::true_type {};
+
+template <typename V, typename T, typename = void>
+struct Has_Enter_Child : std::false_type {};
+template <typename V, typename T>
+struct Has_Enter_Child<V, T, std::void_t<decltype(std::declval<V &>().Enter_Child(std::declval<T>(), std::declval<const BaseAST *>()))>> : std::true_type {};
+
+template <typename V, typename T, typename = void>
+struct Has_Leave : std::false_type {};
+template <typename V, typename T>
+struct Has_Leave<V, T, std::void_t<decltype(std::declval<V &>().Leave(std::declval<T>()))>> : std::true_type {};
+
+// CRTP 的遍历基类, 交给 Walk_AST 驱动
+// 派生类只为关心的结点类型定义 (都是 public 的重载)
+//   void Enter(const XxxAST *node)                            进入结点
+//   bool Enter_Child(const XxxAST *node, const BaseAST *child) 进入孩子之前, 返回 false 跳过
+//   void Leave(const XxxAST *node)                            孩子都处理完之后
+// 没有定义的类型什么都不做
+template <typename Derived>
+class ASTVisitor {
+ public:
+  void Pre(const BaseAST *node) {
+    Visit_As(node, [this](auto n){
+      if constexpr (Has_Enter<Derived, decltype(n)>::value){
+        Self().Enter(n);
+      }
+    });
+  }
+  bool Before(const BaseAST *node, const BaseAST *child) {
+    bool enter = true;
+    Visit_As(node, [this, child, &enter](auto n){
+      if constexpr (Has_Enter_Child<Derived, decltype(n)>::value){
+        enter = Self().Enter_Child(n, child);
+      }
+    });
+    return enter;
+  }
+  void Post(const BaseAST *node) {
+    Visit_As(node, [this](auto n){
+      if constexpr (Has_Leave<Derived, decltype(n)>::value){
+        Self().Leave(n);
+      }
+    });
+  }
+
+ private:
+  Derived &Self() {
+    return *static_cast<Derived *>(this);
+  }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+// 由 AST.h 在 BaseAST 之后引入
+
+#include <cstdint>
+#include <vector>
+
+// 用显式栈遍历以 root 为根的子树, 不受树深度限制
+// 孩子由 BaseAST::Child 按下标依次取出, 每个结点依次调用
+//   visitor.Pre(node)               进入结点
+//   visitor.Before(node, child)     进入孩子之前, 返回 false 跳过这棵子树
+//   visitor.Post(node)              孩子都处理完之后
+// Dump / Semantic_Analysis / Eval 和 ASTExport.h 的导出都由它驱动
+template <typename Visitor>
+void Walk_AST(const BaseAST *root, Visitor &visitor) {
+  // 正在处理的结点和它下一个要处理的孩子的下标
+  typedef struct{
+    const BaseAST *node;
+    uint32_t next;
+  } Frame;
+  std::vector<Frame> stack;
+  visitor.Pre(root);
+  stack.push_back({root, 0});
+  while (!stack.empty()){
+    Frame &f = stack.back();
+    const BaseAST *child = f.node->Child(f.next);
+    if (child == NULL){
+      const BaseAST *node = f.node;
+      stack.pop_back();
+      visitor.Post(node);
+      continue;
+    }
+    f.next++;
+    if (!visitor.Before(f.node, child)){
+      continue;
+    }
+    // push_back 之后 f 可能失效, 不再使用
+    visitor.Pre(child);
+    stack.push_back({child, 0});
+  }
+}
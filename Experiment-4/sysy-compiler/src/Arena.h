@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// bump-pointer 内存池
+// 一次编译产生的所有 AST 结点都从这里分配, 编译结束后整块释放, 不再逐个 delete
+class Arena {
+ public:
+  static const size_t kBlockSize = 64 << 10;
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    Release();
+  }
+
+  void *Alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    size_t offset = (used + align - 1) & ~(align - 1);
+    if (!head || offset + size > capacity){
+      NewBlock(size + align);
+      offset = (used + align - 1) & ~(align - 1);
+    }
+    used = offset + size;
+    return head->data + offset;
+  }
+
+  // 释放所有块, 之前分配出去的指针全部失效
+  void Release() {
+    while (head){
+      Block *next = head->next;
+      free(head);
+      head = next;
+    }
+    used = capacity = 0;
+  }
+
+  size_t BytesAllocated() const {
+    return total;
+  }
+
+ private:
+  struct Block {
+    Block *next;
+    alignas(std::max_align_t) char data[1];
+  };
+
+  Block *head = NULL;
+  size_t used = 0;
+  size_t capacity = 0;
+  size_t total = 0;
+
+  void NewBlock(size_t min_size) {
+    size_t size = min_size > kBlockSize ? min_size : kBlockSize;
+    Block *block = (Block *) malloc(offsetof(Block, data) + size);
+    if (!block){
+      throw std::bad_alloc();
+    }
+    block->next = head;
+    head = block;
+    used = 0;
+    capacity = size;
+    total += size;
+  }
+};
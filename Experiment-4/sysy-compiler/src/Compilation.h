@@ -0,0 +1,116 @@
+#pragma once
+
+// 由 AST.h 在 KoopaIR.h 之后引入
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "Arena.h"
+#include "Intern.h"
+#include "Location.h"
+#include "SourceFile.h"
+#include "SymbolTable.h"
+#include "TokenSink.h"
+
+// sysy.l 里的 lexer 状态 (flex 的 yyscan_t, 手写扫描器, token 流读取), 只在 sysy.l 里完整定义
+struct LexState;
+void lex_destroy(LexState *lexer);
+
+// 批量编译时一个单元出错, 从出错的地方一路抛回调度线程, 只放弃这个单元
+typedef struct{
+  int code;
+} CompileError;
+
+// 一次编译 (一个输入文件) 的全部状态
+// lexer 和 parser 都是可重入的, 显式拿到这个对象; AST 的虚函数层层调用, 通过线程局部的 ctx 找到它
+// 所以 yyparse 之前要先把 ctx 指向它 (建结点时要用它的 arena 和 ast_loc)
+// 每个线程同时只编译一个文件, 不同线程的 Compilation 互不共享, 可以并行
+class Compilation {
+ public:
+  Compilation() : koopa(interner) {}
+  Compilation(const Compilation &) = delete;
+  Compilation &operator=(const Compilation &) = delete;
+
+  ~Compilation() {
+    lex_destroy(lexer);
+  }
+
+  // 输入文件, 整个映射进来
+  SourceFile source_file;
+  // 所有位置都落在这个空间里
+  SourceMap source_map;
+  // 标识符驻留表
+  StringInterner interner;
+  // AST 结点都分配在这里, 编译结束整块回收
+  Arena arena;
+  // yyparse 的解析栈超过初始的 200 层之后搬到这里, 见 sysy.y 的 Grow_Parse_Stack
+  std::vector<char> parse_stacks[3];
+  // 表达式建成折叠的 ExprAST, 不建 Exp 到 PrimaryExp 的整条链, 没有要求输出 AST 时打开
+  bool collapse_exp = false;
+  // 最近一个十进制字面量 2147483648 的位置, 它只能直接作一元 '-' 的操作数, 由 sysy.y 检查
+  Loc int_min_literal = kNoLoc;
+  // 正在归约的产生式的位置, 由 sysy.y 的 YYLLOC_DEFAULT 设置, 新建的 AST 结点都记下它
+  Loc ast_loc = kNoLoc;
+  // -koopa / -koopa-raw / -riscv 的 IR 生成上下文
+  KoopaGen koopa;
+
+  // -lex 输出
+  TokenSink token_sink;
+  bool print_token = false;
+  // 用 Scanner.h 里手写的扫描器代替 flex
+  bool hand_scanner = false;
+  LexState *lexer = NULL;
+
+  // 语义分析
+  SymbolTable symbol_table;
+  FuncSymbol *current_func_symbol_table = NULL;
+  Sym current_func_name = kNoSym;
+
+  // -batch 模式: 报错写进 diag 等调度线程统一输出, 出错时抛 CompileError 而不是退出进程
+  bool batch = false;
+  std::ostringstream diag;
+
+  // 报错都写到这里, 单文件模式就是标准输出
+  std::ostream &Diag() {
+    return batch ? (std::ostream &) diag : std::cout;
+  }
+
+  // 词法和语法错误不马上 Fail, 记下来继续扫描和解析, 解析完有错再 Fail, 一趟报出所有错误
+  // 最多输出 kMaxErrors 条, 之后的只计数
+  static const int kMaxErrors = 100;
+  int error_count = 0;
+
+  // 记一条错误, 返回这条还要不要输出
+  bool Count_Error() {
+    error_count++;
+    if (error_count == kMaxErrors + 1){
+      Diag() << "Error: too many errors, the rest are not reported" << std::endl;
+    }
+    return error_count <= kMaxErrors;
+  }
+
+  // 报完错之后调用, 单文件模式直接以 code 退出
+  [[noreturn]] void Fail(int code) {
+    if (batch){
+      throw CompileError{code};
+    }
+    exit(code);
+  }
+
+  void Print_Token(const char *token, const char *name) {
+    if (print_token){
+      token_sink.Write(token, name);
+    }
+  }
+
+  void Print_Token(const char *token, int value) {
+    if (print_token){
+      token_sink.Write(token, value);
+    }
+  }
+};
+
+// 当前线程正在编译的单元
+extern thread_local Compilation *ctx;
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "AST.h"
+#include "OutputBuffer.h"
+
+// 扁平化的 AST (struct-of-arrays)
+// 结点按前序编号, 每个数组的第 i 项描述第 i 个结点:
+//   kind        结点种类
+//   subtree_end 子树结束的位置 (最后一个后代的下一个), 第一个孩子是 i + 1,
+//               孩子 c 的下一个兄弟是 subtree_end[c]
+//   attr        标识符结点是 Sym (interner 就是标识符的附表), Number 是 literals 的下标,
+//               StmtAST 是 StmtKind, 表达式结点是 OpKind
+// -ast 只由这里输出
+// 空的 unique_ptr 不占结点, 孩子按 -ast 的输出顺序 (BaseAST::Child) 排列,
+// -ast 不输出的 FuncDefOrVarDecl / FuncFParam 的 BType 也不保存
+// 指针树里存成数组的列表在这里还原成 -ast 输出的链表形状:
+//   CompUnits 左递归, 每一项外面包一层 CompUnits, 最后一项在最外层
+//   BlockItem / Brace 右递归, 每一项包一层, 下一层跟在这一项后面
+//   逗号分隔的 ConstDef / VarDef, 后一个定义是前一个的最后一个孩子
+class FlatAST {
+ public:
+  std::vector<ASTKind> kind;
+  std::vector<uint32_t> subtree_end;
+  std::vector<uint32_t> attr;
+  std::vector<int> literals;
+
+  size_t Size() const {
+    return kind.size();
+  }
+
+  // 从指针树转换, 用显式栈, 不受树深度限制, 也不受列表长度限制
+  void Build(const BaseAST *root) {
+    kind.clear();
+    subtree_end.clear();
+    attr.clear();
+    literals.clear();
+
+    std::vector<Frame> stack;
+    std::vector<const BaseAST *> children;
+    stack.push_back({Frame::Node, root, 0});
+    while (!stack.empty()){
+      Frame f = stack.back();
+      stack.pop_back();
+      switch (f.op){
+        case Frame::Close:
+          // 子树结束
+          subtree_end[f.index] = kind.size();
+          break;
+        case Frame::Node:
+          Expand(f.node, stack, children);
+          break;
+        case Frame::Wrap: {
+          // 右递归列表的第 index 层: 包装结点, 这一项, 再下一层
+          const ASTList &items = Items(f.node);
+          uint32_t index = Emit(f.node->kind, 0);
+          stack.push_back({Frame::Close, NULL, index});
+          if (f.index + 1 < items.size()){
+            stack.push_back({Frame::Wrap, f.node, f.index + 1});
+          }
+          stack.push_back({Frame::Node, items[f.index].get(), 0});
+          break;
+        }
+        case Frame::Def: {
+          // 第 index 个定义, 它自己的孩子之后是下一个定义
+          const ASTList &defs = Defs(f.node);
+          const BaseAST *def = defs[f.index].get();
+          uint32_t index = Emit(def->kind, Attr(def));
+          stack.push_back({Frame::Close, NULL, index});
+          if (f.index + 1 < defs.size()){
+            stack.push_back({Frame::Def, f.node, f.index + 1});
+          }
+          PushChildren(def, stack, children);
+          break;
+        }
+      }
+    }
+  }
+
+  // 输出 -ast 的缩进格式, 顺序扫描数组即可, 不递归
+  void Print_AST(OutputBuffer &out) const {
+    // 还没输出 "}" 的结点
+    std::vector<uint32_t> open;
+    int depth = 0;
+    for (uint32_t i = 0; i < Size(); i++){
+      while (!open.empty() && subtree_end[open.back()] <= i){
+        Close(out, open.back(), depth);
+        open.pop_back();
+      }
+      uint32_t parent = open.empty() ? UINT32_MAX : open.back();
+      Open(out, i, parent, depth);
+      open.push_back(i);
+    }
+    while (!open.empty()){
+      Close(out, open.back(), depth);
+      open.pop_back();
+    }
+  }
+
+ private:
+  static const char *Name(ASTKind k) {
+    switch (k){
+      case ASTKind::CompUnit: return "CompUnitAST";
+      case ASTKind::CompUnits: return "CompUnitsAST";
+      case ASTKind::FuncDefOrVarDecl: return "FuncDefOrVarDeclAST";
+      case ASTKind::Decl: return "DeclAST";
+      case ASTKind::ConstDecl: return "ConstDeclAST";
+      case ASTKind::Bracket: return "BracketAST";
+      case ASTKind::ConstInitVal: return "ConstInitValAST";
+      case ASTKind::Brace: return "BraceAST";
+      case ASTKind::ConstExp: return "ConstExpAST";
+      case ASTKind::VarDecl: return "VarDeclAST";
+      case ASTKind::VarDecl_: return "VarDeclAST_";
+      case ASTKind::InitVal: return "InitValAST";
+      case ASTKind::FuncDef: return "FuncDefAST";
+      case ASTKind::FuncType: return "FunctypeAST";
+      case ASTKind::FuncFParams: return "FuncFParamsAST";
+      case ASTKind::Block: return "BlockAST";
+      case ASTKind::BlockItem: return "BlockItemAST";
+      case ASTKind::Stmt: return "StmtAST";
+      case ASTKind::Exp: return "ExpAST";
+      case ASTKind::PrimaryExp: return "PrimaryExpAST";
+      case ASTKind::FuncRParams: return "FuncRParamsAST";
+      case ASTKind::MulExp: return "MulExpAST";
+      case ASTKind::AddExp: return "AddExpAST";
+      case ASTKind::RelExp: return "RelExpAST";
+      case ASTKind::EqExp: return "EqExpAST";
+      case ASTKind::LAndExp: return "LAndExpAST";
+      case ASTKind::LOrExp: return "LOrExpAST";
+      default: return "";
+    }
+  }
+
+  static void Indent(OutputBuffer &out, int depth) {
+    out.Spaces(2*depth);
+  }
+
+  // 结点的开头部分, 之后输出的孩子都在 depth 层
+  void Open(OutputBuffer &out, uint32_t i, uint32_t parent, int &depth) const {
+    switch (kind[i]){
+      case ASTKind::FuncDef_:
+        Indent(out, depth);
+        out << "FuncDefAST { " << '\n';
+        Indent(out, depth);
+        // BType FuncDef_ 的函数类型是 int, 直接挂在 CompUnits 下的是 void
+        out << "TYPE: " << (parent != UINT32_MAX && kind[parent] == ASTKind::FuncDefOrVarDecl ? "int" : "void") << '\n';
+        Indent(out, depth);
+        out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+        break;
+      case ASTKind::BType:
+        Indent(out, depth);
+        out << "BTypeAST {" << '\n';
+        Indent(out, depth);
+        out << "TYPE: int" << '\n';
+        break;
+      case ASTKind::ConstDef:
+        Indent(out, depth);
+        out << "ConstDefAST {" << '\n';
+        Indent(out, depth);
+        out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+        break;
+      case ASTKind::VarDef:
+        Indent(out, depth);
+        out << "VarDefAST { " << '\n';
+        Indent(out, depth);
+        out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+        break;
+      case ASTKind::FuncFParam:
+        Indent(out, depth);
+        out << "FuncFParamAST {" << '\n';
+        break;
+      case ASTKind::LVal:
+        Indent(out, depth);
+        out << "LValAST { " << '\n';
+        out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+        break;
+      case ASTKind::Number:
+        Indent(out, depth);
+        out << "INT_CONST: " << literals[attr[i]] << '\n';
+        break;
+      case ASTKind::UnaryExp:
+        Indent(out, depth);
+        out << "UnaryExpAST {" << '\n';
+        // 函数调用没有孩子, 或者唯一的孩子是 FuncRParams
+        if (subtree_end[i] == i + 1 || kind[i + 1] == ASTKind::FuncRParams){
+          Indent(out, depth);
+          out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+        }
+        break;
+      default:
+        Indent(out, depth);
+        out << Name(kind[i]) << " {" << '\n';
+        break;
+    }
+    depth++;
+
+    // FuncFParamAST 的 BType 不单独成结点, IDENT 在它之后输出
+    if (kind[i] == ASTKind::FuncFParam){
+      Indent(out, depth);
+      out << "BTypeAST {" << '\n';
+      Indent(out, depth);
+      out << "TYPE: int" << '\n';
+      Indent(out, depth);
+      out << "}" << '\n';
+      Indent(out, depth - 1);
+      out << "IDENT: " << ctx->interner.Str(attr[i]) << '\n';
+    }
+  }
+
+  void Close(OutputBuffer &out, uint32_t i, int &depth) const {
+    depth--;
+    if (kind[i] == ASTKind::Number){
+      return;
+    }
+    Indent(out, depth);
+    out << "}" << '\n';
+  }
+
+  // 栈里待处理的一项
+  //   Node  展开 node
+  //   Close 结点 index 的子树到此结束
+  //   Wrap  右递归列表 node 的第 index 层
+  //   Def   定义列表 node 的第 index 个定义
+  typedef struct{
+    enum { Node, Close, Wrap, Def } op;
+    const BaseAST *node;
+    uint32_t index;
+  } Frame;
+
+  uint32_t Emit(ASTKind k, uint32_t a) {
+    kind.push_back(k);
+    subtree_end.push_back(0);
+    attr.push_back(a);
+    return kind.size() - 1;
+  }
+
+  static const ASTList &Items(const BaseAST *node) {
+    if (node->kind == ASTKind::BlockItem){
+      return ((const BlockItemAST *) node)->items;
+    }
+    return ((const BraceAST *) node)->items;
+  }
+
+  static const ASTList &Defs(const BaseAST *node) {
+    switch (node->kind){
+      case ASTKind::ConstDecl: return ((const ConstDeclAST *) node)->const_defs;
+      case ASTKind::VarDecl: return ((const VarDeclAST *) node)->var_defs;
+      default: return ((const VarDeclAST_ *) node)->var_defs;
+    }
+  }
+
+  static void PushChildren(const BaseAST *node, std::vector<Frame> &stack, std::vector<const BaseAST *> &children) {
+    children.clear();
+    Children(node, children);
+    for (size_t i = children.size(); i-- > 0;){
+      stack.push_back({Frame::Node, children[i], 0});
+    }
+  }
+
+  void Expand(const BaseAST *node, std::vector<Frame> &stack, std::vector<const BaseAST *> &children) {
+    switch (node->kind){
+      case ASTKind::CompUnits: {
+        // n 层 CompUnits 连续编号, 第 k 项输出之后关掉由内向外的第 k 层
+        const ASTList &items = ((const CompUnitsAST *) node)->items;
+        uint32_t first = kind.size();
+        for (size_t k = 0; k < items.size(); k++){
+          Emit(ASTKind::CompUnits, 0);
+        }
+        for (size_t k = 0; k < items.size(); k++){
+          stack.push_back({Frame::Close, NULL, (uint32_t) (first + k)});
+          stack.push_back({Frame::Node, items[items.size() - 1 - k].get(), 0});
+        }
+        return;
+      }
+      case ASTKind::BlockItem:
+      case ASTKind::Brace:
+        if (!Items(node).empty()){
+          stack.push_back({Frame::Wrap, node, 0});
+          return;
+        }
+        break;
+      case ASTKind::ConstDecl:
+      case ASTKind::VarDecl:
+      case ASTKind::VarDecl_: {
+        uint32_t index = Emit(node->kind, 0);
+        stack.push_back({Frame::Close, NULL, index});
+        if (!Defs(node).empty()){
+          stack.push_back({Frame::Def, node, 0});
+        }
+        if (node->kind != ASTKind::VarDecl_){
+          const auto &b_type = node->kind == ASTKind::ConstDecl ? ((const ConstDeclAST *) node)->b_type : ((const VarDeclAST *) node)->b_type;
+          stack.push_back({Frame::Node, b_type.get(), 0});
+        }
+        return;
+      }
+      default:
+        break;
+    }
+    uint32_t index = Emit(node->kind, Attr(node));
+    stack.push_back({Frame::Close, NULL, index});
+    PushChildren(node, stack, children);
+  }
+
+  uint32_t Attr(const BaseAST *node) {
+    switch (node->kind){
+      case ASTKind::FuncDef_: return ((const FuncDefAST_ *) node)->ident;
+      case ASTKind::ConstDef: return ((const ConstDefAST *) node)->ident;
+      case ASTKind::VarDef: return ((const VarDefAST *) node)->ident;
+      case ASTKind::FuncDef: return ((const FuncDefAST *) node)->ident;
+      case ASTKind::FuncFParam: return ((const FuncFParamAST *) node)->ident;
+      case ASTKind::LVal: return ((const LValAST *) node)->ident;
+      case ASTKind::UnaryExp: {
+        // 函数调用和一元运算互斥
+        auto n = (const UnaryExpAST *) node;
+        return n->ident != kNoSym ? n->ident : (uint32_t) n->unary_op;
+      }
+      case ASTKind::Stmt: return (uint32_t) ((const StmtAST *) node)->stmt_kind;
+      case ASTKind::MulExp: return (uint32_t) ((const MulExpAST *) node)->mul_op;
+      case ASTKind::AddExp: return (uint32_t) ((const AddExpAST *) node)->add_op;
+      case ASTKind::RelExp: return (uint32_t) ((const RelExpAST *) node)->rel_op;
+      case ASTKind::EqExp: return (uint32_t) ((const EqExpAST *) node)->eq_op;
+      case ASTKind::LAndExp: return (uint32_t) ((const LAndExpAST *) node)->l_and_op;
+      case ASTKind::LOrExp: return (uint32_t) ((const LOrExpAST *) node)->l_or_op;
+      case ASTKind::Number:
+        literals.push_back(((const NumberAST *) node)->number);
+        return literals.size() - 1;
+      default: return 0;
+    }
+  }
+
+ public:
+  // 孩子的顺序就是 -ast 的输出顺序, 即 BaseAST::Child 的顺序
+  // 列表的元素直接作为孩子, 不还原成链表
+  static void Children(const BaseAST *node, std::vector<const BaseAST *> &out) {
+    for (uint32_t i = 0; const BaseAST *child = node->Child(i); i++){
+      out.push_back(child);
+    }
+  }
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// 整数字面量的解码: 一趟同时检查数字, 检查溢出, 算出值
+// 0x / 0X 开头是十六进制, 其余以 0 开头是八进制, 否则是十进制
+// 十进制最大到 2147483648 (值按 32 位回绕成 INT_MIN, 只能作一元 '-' 的操作数, 由 sysy.y 的 Check_Int_Min 检查)
+// 八进制和十六进制按 32 位的位模式, 最大到 0xFFFFFFFF
+typedef struct{
+  enum Status : uint8_t { Ok, Bad_Digit, Overflow };
+  Status status;
+  uint8_t base;
+  int value;
+  size_t bad;     // Bad_Digit: 第一个非法字符在字面量里的下标
+} IntLiteral;
+
+// 字符对应的数字, 不是数字字母的为 0xff
+static constexpr std::array<uint8_t, 256> Int_Literal_Digits() {
+  std::array<uint8_t, 256> t{};
+  for (int c = 0; c < 256; c++){
+    t[c] = 0xff;
+  }
+  for (int c = '0'; c <= '9'; c++){
+    t[c] = c - '0';
+  }
+  for (int c = 'a'; c <= 'z'; c++){
+    t[c] = t[c - 'a' + 'A'] = c - 'a' + 10;
+  }
+  return t;
+}
+
+static inline IntLiteral Decode_Int_Literal(const char *text, size_t len) {
+  static constexpr std::array<uint8_t, 256> digits = Int_Literal_Digits();
+  IntLiteral lit = {IntLiteral::Ok, 10, 0, 0};
+  size_t i = 0;
+  if (len > 1 && text[0] == '0'){
+    if (text[1] == 'x' || text[1] == 'X'){
+      lit.base = 16;
+      i = 2;
+      // 只有 "0x": 缺的第一个数字就是非法的位置
+      if (len == 2){
+        lit.status = IntLiteral::Bad_Digit;
+        lit.bad = 2;
+        return lit;
+      }
+    }else {
+      lit.base = 8;
+      i = 1;
+    }
+  }
+  const uint64_t limit = lit.base == 10 ? 2147483648u : 0xffffffffu;
+  uint64_t value = 0;
+  bool overflow = false;
+  for (; i < len; i++){
+    uint8_t d = digits[(uint8_t) text[i]];
+    if (d >= lit.base){
+      lit.status = IntLiteral::Bad_Digit;
+      lit.bad = i;
+      return lit;
+    }
+    // 超过上限之后不再累加, 但还要接着检查后面的数字
+    if (!overflow){
+      value = value * lit.base + d;
+      overflow = value > limit;
+    }
+  }
+  if (overflow){
+    lit.status = IntLiteral::Overflow;
+    return lit;
+  }
+  lit.value = (int) (uint32_t) value;
+  return lit;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Arena.h"
+
+// 标识符的编号, lexer / parser / 语义分析之间都只传这个 32 位整数
+typedef uint32_t Sym;
+
+// 空串固定是 0 号, 用来表示 "没有标识符"
+static const Sym kNoSym = 0;
+
+// 字符串驻留表, 每个编译单元一份
+// 同一个名字只保存一份, 之后比较、哈希都只用编号
+class StringInterner {
+ public:
+  StringInterner() {
+    slots.assign(1024, kEmpty);
+    Intern("", 0);
+  }
+
+  Sym Intern(const char *str, size_t len) {
+    uint32_t hash = Hash(str, len);
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask){
+      uint32_t id = slots[i];
+      if (id == kEmpty){
+        id = Insert(str, len, hash);
+        slots[i] = id;
+        if (entries.size() * 2 > slots.size()){
+          Grow();
+        }
+        return id;
+      }
+      const Entry &e = entries[id];
+      if (e.hash == hash && e.len == len && memcmp(e.str, str, len) == 0){
+        return id;
+      }
+    }
+  }
+
+  Sym Intern(const std::string &str) {
+    return Intern(str.data(), str.size());
+  }
+
+  // 以 '\0' 结尾, 指针在整个编译过程中保持有效
+  const char *Str(Sym id) const {
+    return entries[id].str;
+  }
+
+  size_t Len(Sym id) const {
+    return entries[id].len;
+  }
+
+  size_t Size() const {
+    return entries.size();
+  }
+
+ private:
+  static const uint32_t kEmpty = 0xffffffffu;
+
+  struct Entry {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+  };
+
+  Arena chars;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> slots;
+
+  static uint32_t Hash(const char *str, size_t len) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++){
+      h ^= (unsigned char) str[i];
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  Sym Insert(const char *str, size_t len, uint32_t hash) {
+    char *copy = (char *) chars.Alloc(len + 1, 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    entries.push_back({copy, (uint32_t) len, hash});
+    return entries.size() - 1;
+  }
+
+  void Grow() {
+    std::vector<uint32_t> old(slots.size() * 2, kEmpty);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (Sym id = 0; id < entries.size(); id++){
+      size_t i = entries[id].hash & mask;
+      while (slots[i] != kEmpty){
+        i = (i + 1) & mask;
+      }
+      slots[i] = id;
+    }
+  }
+};
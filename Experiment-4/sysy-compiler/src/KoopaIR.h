@@ -0,0 +1,638 @@
+#pragma once
+
+// 由 AST.h 在 OpKind 等枚举定义之后引入
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Intern.h"
+#include "KoopaRaw.h"
+#include "OutputBuffer.h"
+#include "SymbolTable.h"
+
+// Koopa IR 中的一个值: 立即数, 临时值 %n, 或者全局 / 局部的具名符号
+// 具名符号不保存字符串, 输出时由 ident 和编号现拼
+// 生成 raw program 时 raw 指向对应的 raw 值, 立即数用到时才建
+typedef struct{
+  enum Kind : uint8_t { None, Imm, Temp, Global, Local };
+  Kind kind;
+  int num;        // Imm 的值, Temp 的编号, Local 的编号
+  Sym ident;      // Global / Local 的名字
+  koopa_raw_value_t raw;
+} Value;
+
+static inline Value Imm_Value(int imm){
+  return {Value::Imm, imm, kNoSym, NULL};
+}
+
+// 基本块的名字 %prefix_id
+typedef struct{
+  const char *prefix;
+  int id;
+} Label;
+
+// 变量在 Koopa 里的样子
+// 标量: addr 是 alloc 出来的 i32 指针
+// 数组: addr 是 alloc 出来的数组指针, dims 是每一维的长度
+// 数组形参: addr 直接是 *[i32, dims...] 类型的形参, 第一维长度未知
+typedef struct{
+  Value addr;
+  bool is_pointer;
+  std::vector<int> dims;
+} VarInfo;
+
+// 函数的形参, value 由 Begin_Function 填上
+typedef struct{
+  Sym ident;
+  bool is_pointer;
+  std::vector<int> dims;
+  Value value;
+} FuncParam;
+
+// 符号表里 Symbol::type 的取值
+enum {
+  KOOPA_CONST = 0,    // value 是常量的值
+  KOOPA_VAR = 1,      // value 是 vars 的下标
+};
+
+// Koopa IR 生成的上下文
+// 默认把文本指令直接流式写进 OutputBuffer; 设置了 raw 时改为在内存里搭 raw program
+class KoopaGen {
+ public:
+  explicit KoopaGen(StringInterner &interner) : interner(interner) {}
+
+  OutputBuffer out;
+  KoopaRawBuilder *raw = NULL;
+  ScopedSymbolTable symbols;
+  std::vector<VarInfo> vars;
+  // 函数名 -> 是否返回 void
+  std::unordered_map<Sym, bool> funcs;
+  // 名字形如 x_1 的全局变量和函数, 由语义分析登记, Reset 不清
+  // 局部变量的 @ident_num 和它们在同一个命名空间里, 编号要避开
+  std::unordered_set<std::string> global_names;
+
+  // 当前函数的状态
+  bool in_function = false;
+  bool is_void = false;
+  bool block_closed = false;
+  int temp_count = 0;
+  int label_count = 0;
+  int local_count = 0;
+  // 进入函数前 vars 的大小, 函数结束后局部变量的 VarInfo 一起丢掉
+  size_t global_vars = 0;
+  // (循环入口, 循环出口), 给 break / continue 用
+  std::vector<std::pair<Label, Label>> loop_stack;
+
+  // 所属编译单元的驻留表
+  StringInterner &interner;
+
+  // 同一棵 AST 再生成一遍之前 (一次调用同时要文本和 raw 两种输出) 清掉上一遍的符号和计数
+  void Reset() {
+    symbols = ScopedSymbolTable();
+    vars.clear();
+    funcs.clear();
+    in_function = false;
+    is_void = false;
+    block_closed = false;
+    temp_count = 0;
+    label_count = 0;
+    local_count = 0;
+    global_vars = 0;
+    loop_stack.clear();
+    raw_funcs.clear();
+    raw_blocks.clear();
+  }
+
+  // SysY 运行时库
+  void Dump_Decls() {
+    static const struct { const char *name; const char *decl; int params; bool is_void; } decls[] = {
+      {"getint", "decl @getint(): i32\n", 0, false},
+      {"getch", "decl @getch(): i32\n", 0, false},
+      {"getarray", "decl @getarray(*i32): i32\n", 1, false},
+      {"putint", "decl @putint(i32)\n", 2, true},
+      {"putch", "decl @putch(i32)\n", 2, true},
+      {"putarray", "decl @putarray(i32, *i32)\n", 3, true},
+      {"starttime", "decl @starttime()\n", 0, true},
+      {"stoptime", "decl @stoptime()\n", 0, true},
+    };
+    for (auto &d : decls){
+      Sym ident = interner.Intern(d.name, strlen(d.name));
+      funcs[ident] = d.is_void;
+      if (!raw){
+        out << d.decl;
+        continue;
+      }
+      // params: 0 无参数, 1 (*i32), 2 (i32), 3 (i32, *i32)
+      std::vector<const void *> params;
+      if (d.params & 2){
+        params.push_back(raw->Int32());
+      }
+      if (d.params & 1){
+        params.push_back(raw->Pointer(raw->Int32()));
+      }
+      koopa_raw_type_t ty = raw->Function(params, d.is_void ? raw->Unit() : raw->Int32());
+      raw_funcs[ident] = raw->Declare_Function(Raw_Name('@', ident, 0), ty);
+    }
+    if (!raw){
+      out << '\n';
+    }
+  }
+
+  void Print(Value v) {
+    switch (v.kind){
+      case Value::Imm:
+        out << v.num;
+        break;
+      case Value::Temp:
+        out << '%' << v.num;
+        break;
+      case Value::Global:
+        out << '@' << interner.Str(v.ident);
+        break;
+      case Value::Local:
+        out << '@' << interner.Str(v.ident) << '_' << v.num;
+        break;
+      case Value::None:
+        break;
+    }
+  }
+
+  void Print(Label l) {
+    out << '%' << l.prefix << '_' << l.id;
+  }
+
+  // [[i32, d2], d1], d0]
+  void Print_Type(const int *dims, int n) {
+    for (int i = 0; i < n; i++){
+      out << '[';
+    }
+    out << "i32";
+    for (int i = n - 1; i >= 0; i--){
+      out << ", " << dims[i] << ']';
+    }
+  }
+
+  // 全局数组的初值 {{1, 2}, {3, 4}}
+  void Print_Aggregate(const int *values, const int *dims, int n) {
+    if (n == 0){
+      out << *values;
+      return;
+    }
+    int stride = 1;
+    for (int i = 1; i < n; i++){
+      stride *= dims[i];
+    }
+    out << '{';
+    for (int i = 0; i < dims[0]; i++){
+      if (i){
+        out << ", ";
+      }
+      Print_Aggregate(values + (size_t) i * stride, dims + 1, n - 1);
+    }
+    out << '}';
+  }
+
+  Label New_Label(const char *prefix) {
+    return {prefix, label_count++};
+  }
+
+  Value New_Temp() {
+    return {Value::Temp, temp_count++, kNoSym, NULL};
+  }
+
+  Value New_Local(Sym ident) {
+    do {
+      ++local_count;
+    } while (!global_names.empty() && global_names.count(Local_Name(ident, local_count)));
+    return {Value::Local, local_count, ident, NULL};
+  }
+
+  // 全局变量或函数的名字以 "_数字" 结尾时才可能和局部变量撞上, 只记这些
+  void Reserve_Global_Name(Sym ident) {
+    const char *s = interner.Str(ident);
+    size_t len = interner.Len(ident);
+    size_t i = len;
+    while (i > 0 && s[i - 1] >= '0' && s[i - 1] <= '9'){
+      i--;
+    }
+    if (i < len && i > 0 && s[i - 1] == '_'){
+      global_names.insert(std::string(s, len));
+    }
+  }
+
+  // 局部变量 ident_num, 不带前缀
+  std::string Local_Name(Sym ident, int num) {
+    std::string name = interner.Str(ident);
+    name += '_';
+    name += std::to_string(num);
+    return name;
+  }
+
+  // 新的基本块, 上一个块没有结束时先跳过来
+  void Dump_Label(Label l) {
+    if (!block_closed){
+      Jump(l);
+    }
+    Start_Block(l);
+  }
+
+  // ret / br / jump 之后的语句放进一个不可达的新块里
+  void Ensure_Block() {
+    if (block_closed){
+      Start_Block(New_Label("dead"));
+    }
+  }
+
+  Value Binary(OpKind op, Value lhs, Value rhs) {
+    if (lhs.kind == Value::Imm && rhs.kind == Value::Imm){
+      int result;
+      if (Fold(op, lhs.num, rhs.num, result)){
+        return Imm_Value(result);
+      }
+    }
+    Ensure_Block();
+    Value v = New_Temp();
+    if (raw){
+      v.raw = raw->Binary(Raw_Op(op), Raw(lhs), Raw(rhs));
+      return v;
+    }
+    out << "  ";
+    Print(v);
+    out << " = " << Op_Name(op) << ' ';
+    Print(lhs);
+    out << ", ";
+    Print(rhs);
+    out << '\n';
+    return v;
+  }
+
+  // 非 0 转成 1
+  Value To_Bool(Value v) {
+    return Binary(OpKind::Ne, v, Imm_Value(0));
+  }
+
+  // ident 为 kNoSym 时是编译器自己用的临时变量
+  Value Alloc(Sym ident, const int *dims, int n) {
+    Ensure_Block();
+    Value v = ident == kNoSym ? New_Temp() : New_Local(ident);
+    if (raw){
+      v.raw = raw->Alloc(raw->Array(dims, n), ident == kNoSym ? NULL : Raw_Name('@', ident, v.num));
+      return v;
+    }
+    out << "  ";
+    Print(v);
+    out << " = alloc ";
+    Print_Type(dims, n);
+    out << '\n';
+    return v;
+  }
+
+  // 全局变量, values 为 NULL 时是 zeroinit
+  Value Global_Alloc(Sym ident, const int *dims, int n, const int *values) {
+    Value v = {Value::Global, 0, ident, NULL};
+    if (raw){
+      koopa_raw_type_t ty = raw->Array(dims, n);
+      koopa_raw_value_t init = values ? Raw_Aggregate(values, ty) : raw->Zero_Init(ty);
+      v.raw = raw->Global_Alloc(Raw_Name('@', ident, 0), init);
+      return v;
+    }
+    out << "global ";
+    Print(v);
+    out << " = alloc ";
+    Print_Type(dims, n);
+    out << ", ";
+    if (values){
+      Print_Aggregate(values, dims, n);
+    }else {
+      out << "zeroinit";
+    }
+    out << '\n';
+    return v;
+  }
+
+  Value Load(Value ptr) {
+    Ensure_Block();
+    Value v = New_Temp();
+    if (raw){
+      v.raw = raw->Load(Raw(ptr));
+      return v;
+    }
+    out << "  ";
+    Print(v);
+    out << " = load ";
+    Print(ptr);
+    out << '\n';
+    return v;
+  }
+
+  void Store(Value v, Value ptr) {
+    Ensure_Block();
+    if (raw){
+      raw->Store(Raw(v), Raw(ptr));
+      return;
+    }
+    out << "  store ";
+    Print(v);
+    out << ", ";
+    Print(ptr);
+    out << '\n';
+  }
+
+  // getelemptr 用于数组指针, getptr 用于数组形参这样的普通指针
+  Value Get_Ptr(Value ptr, Value index, bool elem) {
+    Ensure_Block();
+    Value v = New_Temp();
+    if (raw){
+      v.raw = elem ? raw->Get_Elem_Ptr(Raw(ptr), Raw(index)) : raw->Get_Ptr(Raw(ptr), Raw(index));
+      return v;
+    }
+    out << "  ";
+    Print(v);
+    out << (elem ? " = getelemptr " : " = getptr ");
+    Print(ptr);
+    out << ", ";
+    Print(index);
+    out << '\n';
+    return v;
+  }
+
+  void Jump(Label l) {
+    Ensure_Block();
+    block_closed = true;
+    if (raw){
+      raw->Jump(Raw_Block(l));
+      return;
+    }
+    out << "  jump ";
+    Print(l);
+    out << '\n';
+  }
+
+  void Branch(Value cond, Label then_label, Label else_label) {
+    Ensure_Block();
+    block_closed = true;
+    if (raw){
+      raw->Branch(Raw(cond), Raw_Block(then_label), Raw_Block(else_label));
+      return;
+    }
+    out << "  br ";
+    Print(cond);
+    out << ", ";
+    Print(then_label);
+    out << ", ";
+    Print(else_label);
+    out << '\n';
+  }
+
+  void Return(const Value *v) {
+    Ensure_Block();
+    block_closed = true;
+    if (raw){
+      raw->Return(v ? Raw(*v) : NULL);
+      return;
+    }
+    out << "  ret";
+    if (v){
+      out << ' ';
+      Print(*v);
+    }
+    out << '\n';
+  }
+
+  Value Call(Sym func, const std::vector<Value> &args) {
+    Ensure_Block();
+    Value v = {Value::None, 0, kNoSym, NULL};
+    if (!funcs[func]){
+      v = New_Temp();
+    }
+    if (raw){
+      std::vector<const void *> raw_args;
+      for (const Value &arg : args){
+        raw_args.push_back(Raw(arg));
+      }
+      v.raw = raw->Call(raw_funcs[func], raw_args);
+      return v;
+    }
+    out << "  ";
+    if (v.kind != Value::None){
+      Print(v);
+      out << " = ";
+    }
+    out << "call @" << interner.Str(func) << '(';
+    for (size_t i = 0; i < args.size(); i++){
+      if (i){
+        out << ", ";
+      }
+      Print(args[i]);
+    }
+    out << ")\n";
+    return v;
+  }
+
+  // 输出函数头和 %entry, 顺便给每个形参编号
+  void Begin_Function(Sym ident, bool returns_void, std::vector<FuncParam> &params) {
+    in_function = true;
+    is_void = returns_void;
+    funcs[ident] = returns_void;
+    block_closed = false;
+    temp_count = 0;
+    label_count = 0;
+    local_count = 0;
+    global_vars = vars.size();
+    loop_stack.clear();
+    raw_blocks.clear();
+    for (FuncParam &param : params){
+      param.value = New_Local(param.ident);
+    }
+
+    if (raw){
+      std::vector<const void *> types, values;
+      for (size_t i = 0; i < params.size(); i++){
+        koopa_raw_type_t ty = raw->Array(params[i].dims.data(), (int) params[i].dims.size());
+        if (params[i].is_pointer){
+          ty = raw->Pointer(ty);
+        }
+        types.push_back(ty);
+        params[i].value.raw = raw->Func_Arg(i, ty, Raw_Name('@', params[i].ident, params[i].value.num));
+        values.push_back(params[i].value.raw);
+      }
+      koopa_raw_type_t ty = raw->Function(types, returns_void ? raw->Unit() : raw->Int32());
+      koopa_raw_function_data_t *func = raw->Declare_Function(Raw_Name('@', ident, 0), ty);
+      raw_funcs[ident] = func;
+      raw->Begin_Function(func, values);
+      raw->Start_Block(raw->New_Block("%entry"));
+      return;
+    }
+
+    out << "fun @" << interner.Str(ident) << '(';
+    for (size_t i = 0; i < params.size(); i++){
+      if (i){
+        out << ", ";
+      }
+      Print(params[i].value);
+      out << ": ";
+      if (params[i].is_pointer){
+        out << '*';
+      }
+      Print_Type(params[i].dims.data(), (int) params[i].dims.size());
+    }
+    out << ')';
+    if (!returns_void){
+      out << ": i32";
+    }
+    out << " {\n%entry:\n";
+  }
+
+  void End_Function() {
+    if (!block_closed){
+      if (is_void){
+        Return(NULL);
+      }else {
+        Value zero = Imm_Value(0);
+        Return(&zero);
+      }
+    }
+    if (raw){
+      raw->End_Function();
+    }else {
+      out << "}\n\n";
+    }
+    vars.resize(global_vars);
+    in_function = false;
+  }
+
+  Value Declare_Var(Sym ident, Value addr, bool is_pointer, const int *dims, int n) {
+    vars.push_back({addr, is_pointer, std::vector<int>(dims, dims + n)});
+    symbols.Declare(ident, {KOOPA_VAR, (int) vars.size() - 1, 0});
+    return addr;
+  }
+
+  void Declare_Const(Sym ident, int value) {
+    symbols.Declare(ident, {KOOPA_CONST, value, 0});
+  }
+
+  static bool Fold(OpKind op, int l, int r, int &result) {
+    switch (op){
+      case OpKind::Add: result = (int) ((unsigned) l + (unsigned) r); return true;
+      case OpKind::Sub: result = (int) ((unsigned) l - (unsigned) r); return true;
+      case OpKind::Mul: result = (int) ((unsigned) l * (unsigned) r); return true;
+      case OpKind::Div:
+        if (r == 0 || (l == INT32_MIN && r == -1)){
+          return false;
+        }
+        result = l / r;
+        return true;
+      case OpKind::Mod:
+        if (r == 0 || (l == INT32_MIN && r == -1)){
+          return false;
+        }
+        result = l % r;
+        return true;
+      case OpKind::Lt: result = l < r; return true;
+      case OpKind::Gt: result = l > r; return true;
+      case OpKind::Le: result = l <= r; return true;
+      case OpKind::Ge: result = l >= r; return true;
+      case OpKind::Eq: result = l == r; return true;
+      case OpKind::Ne: result = l != r; return true;
+      case OpKind::And: result = l && r; return true;
+      case OpKind::Or: result = l || r; return true;
+      default: return false;
+    }
+  }
+
+  static const char *Op_Name(OpKind op) {
+    switch (op){
+      case OpKind::Add: return "add";
+      case OpKind::Sub: return "sub";
+      case OpKind::Mul: return "mul";
+      case OpKind::Div: return "div";
+      case OpKind::Mod: return "mod";
+      case OpKind::Lt: return "lt";
+      case OpKind::Gt: return "gt";
+      case OpKind::Le: return "le";
+      case OpKind::Ge: return "ge";
+      case OpKind::Eq: return "eq";
+      case OpKind::Ne: return "ne";
+      case OpKind::And: return "and";
+      case OpKind::Or: return "or";
+      default: return "";
+    }
+  }
+
+ private:
+  // raw 模式下的函数和当前函数里按名字找到的基本块
+  std::unordered_map<Sym, koopa_raw_function_data_t *> raw_funcs;
+  std::unordered_map<std::string, koopa_raw_basic_block_data_t *> raw_blocks;
+
+  void Start_Block(Label l) {
+    block_closed = false;
+    if (raw){
+      raw->Start_Block(Raw_Block(l));
+      return;
+    }
+    Print(l);
+    out << ":\n";
+  }
+
+  // 立即数在 raw 里也是一个值, 每次用到时新建一个
+  koopa_raw_value_t Raw(Value v) {
+    return v.kind == Value::Imm ? raw->Integer(v.num) : v.raw;
+  }
+
+  // "@ident" 或者 "@ident_num"
+  const char *Raw_Name(char prefix, Sym ident, int num) {
+    std::string name(1, prefix);
+    name += num ? Local_Name(ident, num) : interner.Str(ident);
+    return raw->Name(name.data(), name.size());
+  }
+
+  // 跳转可以出现在基本块定义之前, 第一次用到时建块
+  koopa_raw_basic_block_data_t *Raw_Block(Label l) {
+    std::string name = std::string("%") + l.prefix + '_' + std::to_string(l.id);
+    auto it = raw_blocks.find(name);
+    if (it != raw_blocks.end()){
+      return it->second;
+    }
+    koopa_raw_basic_block_data_t *bb = raw->New_Block(raw->Name(name.data(), name.size()));
+    raw_blocks[name] = bb;
+    return bb;
+  }
+
+  // 按 ty 的形状把展开的初值重新拼成嵌套的 aggregate
+  koopa_raw_value_t Raw_Aggregate(const int *values, koopa_raw_type_t ty) {
+    if (ty->tag == KOOPA_RTT_INT32){
+      return raw->Integer(*values);
+    }
+    size_t stride = 1;
+    for (koopa_raw_type_t t = ty->data.array.base; t->tag == KOOPA_RTT_ARRAY; t = t->data.array.base){
+      stride *= t->data.array.len;
+    }
+    std::vector<const void *> elems;
+    for (size_t i = 0; i < ty->data.array.len; i++){
+      elems.push_back(Raw_Aggregate(values + i * stride, ty->data.array.base));
+    }
+    return raw->Aggregate(elems, ty);
+  }
+
+  static koopa_raw_binary_op_t Raw_Op(OpKind op) {
+    switch (op){
+      case OpKind::Add: return KOOPA_RBO_ADD;
+      case OpKind::Sub: return KOOPA_RBO_SUB;
+      case OpKind::Mul: return KOOPA_RBO_MUL;
+      case OpKind::Div: return KOOPA_RBO_DIV;
+      case OpKind::Mod: return KOOPA_RBO_MOD;
+      case OpKind::Lt: return KOOPA_RBO_LT;
+      case OpKind::Gt: return KOOPA_RBO_GT;
+      case OpKind::Le: return KOOPA_RBO_LE;
+      case OpKind::Ge: return KOOPA_RBO_GE;
+      case OpKind::Eq: return KOOPA_RBO_EQ;
+      case OpKind::Ne: return KOOPA_RBO_NOT_EQ;
+      case OpKind::And: return KOOPA_RBO_AND;
+      case OpKind::Or: return KOOPA_RBO_OR;
+      default: return KOOPA_RBO_ADD;
+    }
+  }
+};
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "koopa.h"
+#include "Arena.h"
+
+// 直接在内存里搭 libkoopa 的 raw program, 省掉输出文本再 parse 回来的一趟
+// 所有结构体都分配在 builder 自己的 arena 里, 和 builder 同生命周期
+// 基本块和指令先攒在 vector 里, 函数结束时才拷成 raw slice
+class KoopaRawBuilder {
+ public:
+  KoopaRawBuilder() {
+    int32_type = New_Type(KOOPA_RTT_INT32);
+    unit_type = New_Type(KOOPA_RTT_UNIT);
+    program.values = Make_Slice(globals, KOOPA_RSIK_VALUE);
+    program.funcs = Make_Slice(funcs, KOOPA_RSIK_FUNCTION);
+  }
+
+  KoopaRawBuilder(const KoopaRawBuilder &) = delete;
+  KoopaRawBuilder &operator=(const KoopaRawBuilder &) = delete;
+
+  // 所有函数生成完之后调用, 填好全局的 slice 和每个值的 used_by
+  const koopa_raw_program_t &Finish() {
+    program.values = Make_Slice(globals, KOOPA_RSIK_VALUE);
+    program.funcs = Make_Slice(funcs, KOOPA_RSIK_FUNCTION);
+    Fill_Used_By();
+    return program;
+  }
+
+  const koopa_raw_program_t &Program() const {
+    return program;
+  }
+
+  // 名字拷进 arena, raw program 里的字符串都要活得和它一样久
+  const char *Name(const char *str, size_t len) {
+    char *name = (char *) arena.Alloc(len + 1, 1);
+    memcpy(name, str, len);
+    name[len] = '\0';
+    return name;
+  }
+
+  // ---------- 类型 ----------
+
+  koopa_raw_type_t Int32() const {
+    return int32_type;
+  }
+
+  koopa_raw_type_t Unit() const {
+    return unit_type;
+  }
+
+  koopa_raw_type_t Pointer(koopa_raw_type_t base) {
+    auto it = pointer_types.find(base);
+    if (it != pointer_types.end()){
+      return it->second;
+    }
+    koopa_raw_type_kind_t *ty = New_Type(KOOPA_RTT_POINTER);
+    ty->data.pointer.base = base;
+    pointer_types[base] = ty;
+    return ty;
+  }
+
+  koopa_raw_type_t Array(koopa_raw_type_t base, size_t len) {
+    auto key = std::make_pair(base, len);
+    auto it = array_types.find(key);
+    if (it != array_types.end()){
+      return it->second;
+    }
+    koopa_raw_type_kind_t *ty = New_Type(KOOPA_RTT_ARRAY);
+    ty->data.array.base = base;
+    ty->data.array.len = len;
+    array_types[key] = ty;
+    return ty;
+  }
+
+  // [[i32, d2], d1], d0]
+  koopa_raw_type_t Array(const int *dims, int n) {
+    koopa_raw_type_t ty = int32_type;
+    for (int i = n - 1; i >= 0; i--){
+      ty = Array(ty, dims[i]);
+    }
+    return ty;
+  }
+
+  koopa_raw_type_t Function(const std::vector<const void *> &params, koopa_raw_type_t ret) {
+    koopa_raw_type_kind_t *ty = New_Type(KOOPA_RTT_FUNCTION);
+    ty->data.function.params = Make_Slice(params, KOOPA_RSIK_TYPE);
+    ty->data.function.ret = ret;
+    return ty;
+  }
+
+  // ---------- 函数和基本块 ----------
+
+  // 只有声明没有函数体的函数 (运行时库) bbs 为空
+  koopa_raw_function_data_t *Declare_Function(const char *name, koopa_raw_type_t ty) {
+    auto func = New<koopa_raw_function_data_t>();
+    func->ty = ty;
+    func->name = name;
+    func->params = Empty_Slice(KOOPA_RSIK_VALUE);
+    func->bbs = Empty_Slice(KOOPA_RSIK_BASIC_BLOCK);
+    funcs.push_back(func);
+    return func;
+  }
+
+  koopa_raw_value_t Func_Arg(size_t index, koopa_raw_type_t ty, const char *name) {
+    auto v = New_Value(ty, name, KOOPA_RVT_FUNC_ARG_REF);
+    v->kind.data.func_arg_ref.index = index;
+    return v;
+  }
+
+  void Begin_Function(koopa_raw_function_data_t *func, const std::vector<const void *> &params) {
+    current_func = func;
+    func->params = Make_Slice(params, KOOPA_RSIK_VALUE);
+    bbs.clear();
+    insts.clear();
+  }
+
+  void End_Function() {
+    for (size_t i = 0; i < bbs.size(); i++){
+      bbs[i]->insts = Make_Slice(insts[i], KOOPA_RSIK_VALUE);
+    }
+    std::vector<const void *> list(bbs.begin(), bbs.end());
+    current_func->bbs = Make_Slice(list, KOOPA_RSIK_BASIC_BLOCK);
+    current_func = NULL;
+  }
+
+  // 新建的基本块先不放进函数, 等 Start_Block 时才按顺序排进去, 这样可以先跳再定义
+  koopa_raw_basic_block_data_t *New_Block(const char *name) {
+    auto bb = New<koopa_raw_basic_block_data_t>();
+    bb->name = name;
+    bb->params = Empty_Slice(KOOPA_RSIK_VALUE);
+    bb->used_by = Empty_Slice(KOOPA_RSIK_VALUE);
+    bb->insts = Empty_Slice(KOOPA_RSIK_VALUE);
+    return bb;
+  }
+
+  void Start_Block(koopa_raw_basic_block_data_t *bb) {
+    bbs.push_back(bb);
+    insts.emplace_back();
+  }
+
+  // ---------- 常量和全局变量 ----------
+
+  koopa_raw_value_t Integer(int value) {
+    auto v = New_Value(int32_type, NULL, KOOPA_RVT_INTEGER);
+    v->kind.data.integer.value = value;
+    return v;
+  }
+
+  koopa_raw_value_t Zero_Init(koopa_raw_type_t ty) {
+    return New_Value(ty, NULL, KOOPA_RVT_ZERO_INIT);
+  }
+
+  koopa_raw_value_t Aggregate(const std::vector<const void *> &elems, koopa_raw_type_t ty) {
+    auto v = New_Value(ty, NULL, KOOPA_RVT_AGGREGATE);
+    v->kind.data.aggregate.elems = Make_Slice(elems, KOOPA_RSIK_VALUE);
+    return v;
+  }
+
+  koopa_raw_value_t Global_Alloc(const char *name, koopa_raw_value_t init) {
+    auto v = New_Value(Pointer(init->ty), name, KOOPA_RVT_GLOBAL_ALLOC);
+    v->kind.data.global_alloc.init = init;
+    globals.push_back(v);
+    return v;
+  }
+
+  // ---------- 指令, 都追加到当前基本块的末尾 ----------
+
+  koopa_raw_value_t Alloc(koopa_raw_type_t ty, const char *name) {
+    return Append(New_Value(Pointer(ty), name, KOOPA_RVT_ALLOC));
+  }
+
+  koopa_raw_value_t Load(koopa_raw_value_t src) {
+    auto v = New_Value(src->ty->data.pointer.base, NULL, KOOPA_RVT_LOAD);
+    v->kind.data.load.src = src;
+    return Append(v);
+  }
+
+  koopa_raw_value_t Store(koopa_raw_value_t value, koopa_raw_value_t dest) {
+    auto v = New_Value(unit_type, NULL, KOOPA_RVT_STORE);
+    v->kind.data.store.value = value;
+    v->kind.data.store.dest = dest;
+    return Append(v);
+  }
+
+  koopa_raw_value_t Get_Ptr(koopa_raw_value_t src, koopa_raw_value_t index) {
+    auto v = New_Value(src->ty, NULL, KOOPA_RVT_GET_PTR);
+    v->kind.data.get_ptr.src = src;
+    v->kind.data.get_ptr.index = index;
+    return Append(v);
+  }
+
+  koopa_raw_value_t Get_Elem_Ptr(koopa_raw_value_t src, koopa_raw_value_t index) {
+    koopa_raw_type_t elem = src->ty->data.pointer.base->data.array.base;
+    auto v = New_Value(Pointer(elem), NULL, KOOPA_RVT_GET_ELEM_PTR);
+    v->kind.data.get_elem_ptr.src = src;
+    v->kind.data.get_elem_ptr.index = index;
+    return Append(v);
+  }
+
+  koopa_raw_value_t Binary(koopa_raw_binary_op_t op, koopa_raw_value_t lhs, koopa_raw_value_t rhs) {
+    auto v = New_Value(int32_type, NULL, KOOPA_RVT_BINARY);
+    v->kind.data.binary.op = op;
+    v->kind.data.binary.lhs = lhs;
+    v->kind.data.binary.rhs = rhs;
+    return Append(v);
+  }
+
+  koopa_raw_value_t Branch(koopa_raw_value_t cond, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) {
+    auto v = New_Value(unit_type, NULL, KOOPA_RVT_BRANCH);
+    v->kind.data.branch.cond = cond;
+    v->kind.data.branch.true_bb = true_bb;
+    v->kind.data.branch.false_bb = false_bb;
+    v->kind.data.branch.true_args = Empty_Slice(KOOPA_RSIK_VALUE);
+    v->kind.data.branch.false_args = Empty_Slice(KOOPA_RSIK_VALUE);
+    return Append(v);
+  }
+
+  koopa_raw_value_t Jump(koopa_raw_basic_block_t target) {
+    auto v = New_Value(unit_type, NULL, KOOPA_RVT_JUMP);
+    v->kind.data.jump.target = target;
+    v->kind.data.jump.args = Empty_Slice(KOOPA_RSIK_VALUE);
+    return Append(v);
+  }
+
+  koopa_raw_value_t Call(koopa_raw_function_t callee, const std::vector<const void *> &args) {
+    auto v = New_Value(callee->ty->data.function.ret, NULL, KOOPA_RVT_CALL);
+    v->kind.data.call.callee = callee;
+    v->kind.data.call.args = Make_Slice(args, KOOPA_RSIK_VALUE);
+    return Append(v);
+  }
+
+  // value 为 NULL 时是 void 函数的 ret
+  koopa_raw_value_t Return(koopa_raw_value_t value) {
+    auto v = New_Value(unit_type, NULL, KOOPA_RVT_RETURN);
+    v->kind.data.ret.value = value;
+    return Append(v);
+  }
+
+ private:
+  Arena arena;
+  koopa_raw_program_t program;
+  koopa_raw_type_t int32_type;
+  koopa_raw_type_t unit_type;
+  std::unordered_map<koopa_raw_type_t, koopa_raw_type_t> pointer_types;
+  std::map<std::pair<koopa_raw_type_t, size_t>, koopa_raw_type_t> array_types;
+
+  std::vector<const void *> globals;
+  std::vector<const void *> funcs;
+
+  // 当前函数已经排好的基本块, 以及每个块里的指令
+  koopa_raw_function_data_t *current_func = NULL;
+  std::vector<koopa_raw_basic_block_data_t *> bbs;
+  std::vector<std::vector<const void *>> insts;
+
+  template <typename T>
+  T *New() {
+    T *p = (T *) arena.Alloc(sizeof(T), alignof(T));
+    memset(p, 0, sizeof(T));
+    return p;
+  }
+
+  koopa_raw_type_kind_t *New_Type(koopa_raw_type_tag_t tag) {
+    auto ty = New<koopa_raw_type_kind_t>();
+    ty->tag = tag;
+    return ty;
+  }
+
+  koopa_raw_value_data_t *New_Value(koopa_raw_type_t ty, const char *name, koopa_raw_value_tag_t tag) {
+    auto v = New<koopa_raw_value_data_t>();
+    v->ty = ty;
+    v->name = name;
+    v->used_by = Empty_Slice(KOOPA_RSIK_VALUE);
+    v->kind.tag = tag;
+    return v;
+  }
+
+  koopa_raw_value_t Append(koopa_raw_value_t v) {
+    insts.back().push_back(v);
+    return v;
+  }
+
+  koopa_raw_slice_t Empty_Slice(koopa_raw_slice_item_kind_t kind) {
+    return {NULL, 0, kind};
+  }
+
+  koopa_raw_slice_t Make_Slice(const std::vector<const void *> &items, koopa_raw_slice_item_kind_t kind) {
+    if (items.empty()){
+      return Empty_Slice(kind);
+    }
+    auto buffer = (const void **) arena.Alloc(items.size() * sizeof(void *), alignof(void *));
+    memcpy(buffer, items.data(), items.size() * sizeof(void *));
+    return {buffer, (uint32_t) items.size(), kind};
+  }
+
+  // 扫一遍所有指令, 把每个操作数 (值或基本块) 的使用者记下来
+  void Fill_Used_By() {
+    std::unordered_map<const void *, std::vector<const void *>> users;
+    std::unordered_map<const void *, std::vector<const void *>> block_users;
+    auto use = [&](const void *operand, const void *user){
+      if (operand){
+        users[operand].push_back(user);
+      }
+    };
+    auto use_block = [&](const void *bb, const void *user){
+      block_users[bb].push_back(user);
+    };
+    auto use_slice = [&](const koopa_raw_slice_t &slice, const void *user){
+      for (uint32_t i = 0; i < slice.len; i++){
+        use(slice.buffer[i], user);
+      }
+    };
+    auto use_value = [&](koopa_raw_value_t v){
+      const auto &d = v->kind.data;
+      switch (v->kind.tag){
+        case KOOPA_RVT_AGGREGATE: use_slice(d.aggregate.elems, v); break;
+        case KOOPA_RVT_GLOBAL_ALLOC: use(d.global_alloc.init, v); break;
+        case KOOPA_RVT_LOAD: use(d.load.src, v); break;
+        case KOOPA_RVT_STORE: use(d.store.value, v); use(d.store.dest, v); break;
+        case KOOPA_RVT_GET_PTR: use(d.get_ptr.src, v); use(d.get_ptr.index, v); break;
+        case KOOPA_RVT_GET_ELEM_PTR: use(d.get_elem_ptr.src, v); use(d.get_elem_ptr.index, v); break;
+        case KOOPA_RVT_BINARY: use(d.binary.lhs, v); use(d.binary.rhs, v); break;
+        case KOOPA_RVT_BRANCH: use(d.branch.cond, v); use_block(d.branch.true_bb, v); use_block(d.branch.false_bb, v); break;
+        case KOOPA_RVT_JUMP: use_block(d.jump.target, v); break;
+        case KOOPA_RVT_CALL: use_slice(d.call.args, v); break;
+        case KOOPA_RVT_RETURN: use(d.ret.value, v); break;
+        default: break;
+      }
+    };
+    for (const void *g : globals){
+      use_value((koopa_raw_value_t) g);
+    }
+    for (const void *f : funcs){
+      auto func = (koopa_raw_function_t) f;
+      for (uint32_t i = 0; i < func->bbs.len; i++){
+        auto bb = (koopa_raw_basic_block_t) func->bbs.buffer[i];
+        for (uint32_t j = 0; j < bb->insts.len; j++){
+          use_value((koopa_raw_value_t) bb->insts.buffer[j]);
+        }
+      }
+    }
+    // 值和基本块都是 builder 自己分配的, 这里去掉 const 写回 used_by
+    for (auto &entry : users){
+      ((koopa_raw_value_data_t *) entry.first)->used_by = Make_Slice(entry.second, KOOPA_RSIK_VALUE);
+    }
+    for (auto &entry : block_users){
+      ((koopa_raw_basic_block_data_t *) entry.first)->used_by = Make_Slice(entry.second, KOOPA_RSIK_VALUE);
+    }
+  }
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 源码位置: 所有输入文件排在同一个 32 位的偏移空间里, 每个文件占 [base, base + size] 一段
+// token 和 AST 结点上只存这一个整数, 报错时才查出是哪个文件, 第几行第几列
+typedef uint32_t Loc;
+
+// 0 号位置不属于任何文件, 表示 "没有位置"
+static const Loc kNoLoc = 0;
+
+typedef struct{
+  const char *file;
+  uint32_t line;
+  uint32_t column;
+} SourcePos;
+
+// 报错用的 "line: 3, column: 7"
+inline std::ostream &operator<<(std::ostream &os, const SourcePos &pos) {
+  return os << "line: " << pos.line << ", column: " << pos.column;
+}
+
+class SourceMap {
+ public:
+  // 登记一个文件, 返回它的起始位置, 文件内偏移 offset 的位置就是 base + offset
+  // data 为 NULL 时没有源文本 (从 token 流读入), 行首由 Add_Line 逐个登记
+  // 有源文本时在这里就扫好换行: 扫描开始后 flex 会临时把当前 token 后面的一个字符改成 '\0'
+  Loc Add_File(const char *name, const char *data, size_t size) {
+    File f;
+    f.name = name;
+    f.base = next;
+    f.size = size;
+    // 第 1 行的行首一定是 0, token 流只在换行时才登记行首
+    f.lines.push_back({0, 1});
+    if (data != NULL){
+      Build_Index(f, data);
+    }
+    files.push_back(std::move(f));
+    // 文件结尾 (EOF) 也要有位置
+    next += size + 1;
+    return files.back().base;
+  }
+
+  // 最后登记的文件里, offset 是第 line 行的行首; 按顺序登记, 中间没有 token 的行可以跳过
+  void Add_Line(uint32_t offset, uint32_t line) {
+    std::vector<LineStart> &lines = files.back().lines;
+    if (lines.empty() || lines.back().line < line){
+      lines.push_back({offset, line});
+    }
+  }
+
+  // 返回的文件名在下一次 Add_File 之前有效
+  SourcePos Decode(Loc loc) {
+    if (loc == kNoLoc || files.empty()){
+      return {"", 0, 0};
+    }
+    auto file = std::upper_bound(files.begin(), files.end(), loc,
+                                 [](Loc l, const File &f) { return l < f.base; }) - 1;
+    uint32_t offset = loc - file->base;
+    auto line = std::upper_bound(file->lines.begin(), file->lines.end(), offset,
+                                 [](uint32_t o, const LineStart &s) { return o < s.offset; });
+    if (line == file->lines.begin()){
+      return {file->name.c_str(), 0, 0};
+    }
+    --line;
+    return {file->name.c_str(), line->line, offset - line->offset + 1};
+  }
+
+  uint32_t Line(Loc loc) {
+    return Decode(loc).line;
+  }
+
+ private:
+  typedef struct{
+    uint32_t offset;
+    uint32_t line;
+  } LineStart;
+
+  typedef struct{
+    std::string name;
+    Loc base;
+    size_t size;
+    std::vector<LineStart> lines;
+  } File;
+
+  std::vector<File> files;
+  Loc next = 1;
+
+  // 登记文件时扫一遍换行, 之后 Decode 都是二分查找
+  static void Build_Index(File &f, const char *data) {
+    const char *p = data;
+    const char *end = data + f.size;
+    uint32_t line = 1;
+    while ((p = (const char *) memchr(p, '\n', end - p)) != NULL){
+      p++;
+      f.lines.push_back({(uint32_t) (p - data), ++line});
+    }
+  }
+};
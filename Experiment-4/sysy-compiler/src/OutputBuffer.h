@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+// OutputBuffer::Spaces 用的一整块空格, 编译期填好
+typedef struct SpaceSlab{
+  char s[256];
+  constexpr SpaceSlab() : s() {
+    for (char &c : s){
+      c = ' ';
+    }
+  }
+} SpaceSlab;
+
+// 带缓冲的文件输出
+// 输出文件只打开一次, 内容先追加到内存缓冲区里, 缓冲区满了再整块 write 出去
+// 写出错 (比如磁盘满了) 之后的内容都丢掉, 由 Flush / Close 返回 false 报告给调用者
+class OutputBuffer {
+ public:
+  static const size_t kBufferSize = 1 << 20;
+
+  OutputBuffer() = default;
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+  ~OutputBuffer() {
+    Close();
+  }
+
+  bool Open(const char *path) {
+    Close();
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+      return false;
+    }
+    if (!buffer){
+      buffer = (char *) malloc(kBufferSize);
+    }
+    if (!buffer){
+      close(fd);
+      fd = -1;
+      return false;
+    }
+    used = 0;
+    failed = false;
+    return true;
+  }
+
+  bool IsOpen() const {
+    return fd >= 0;
+  }
+
+  void Write(const char *data, size_t len) {
+    if (used + len > kBufferSize){
+      Flush();
+      if (len > kBufferSize){
+        // 超长的内容直接写出, 不经过缓冲区
+        WriteAll(data, len);
+        return;
+      }
+    }
+    memcpy(buffer + used, data, len);
+    used += len;
+  }
+
+  OutputBuffer &operator<<(const char *str) {
+    Write(str, strlen(str));
+    return *this;
+  }
+
+  OutputBuffer &operator<<(const std::string &str) {
+    Write(str.data(), str.size());
+    return *this;
+  }
+
+  OutputBuffer &operator<<(char c) {
+    if (used == kBufferSize){
+      Flush();
+    }
+    buffer[used++] = c;
+    return *this;
+  }
+
+  // 十进制整数, 不经过 std::to_string
+  OutputBuffer &operator<<(int value) {
+    char digits[16];
+    char *end = digits + sizeof(digits);
+    char *p = end;
+    unsigned int v = value < 0 ? 0u - (unsigned int) value : (unsigned int) value;
+    do {
+      *--p = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    if (value < 0){
+      *--p = '-';
+    }
+    Write(p, end - p);
+    return *this;
+  }
+
+  // n 个空格, 从静态的空格块里整段拷贝, 不用每行临时构造一个 std::string
+  void Spaces(size_t n) {
+    static constexpr SpaceSlab kSpaces{};
+    while (n > sizeof(kSpaces.s)){
+      Write(kSpaces.s, sizeof(kSpaces.s));
+      n -= sizeof(kSpaces.s);
+    }
+    Write(kSpaces.s, n);
+  }
+
+  // 返回到目前为止的内容是不是都写出去了
+  bool Flush() {
+    if (used){
+      WriteAll(buffer, used);
+      used = 0;
+    }
+    return !failed;
+  }
+
+  bool Close() {
+    if (fd >= 0){
+      Flush();
+      if (close(fd) != 0){
+        failed = true;
+      }
+      fd = -1;
+    }
+    free(buffer);
+    buffer = NULL;
+    return !failed;
+  }
+
+ private:
+  int fd = -1;
+  char *buffer = NULL;
+  size_t used = 0;
+  bool failed = false;
+
+  void WriteAll(const char *data, size_t len) {
+    while (len && !failed){
+      ssize_t n = write(fd, data, len);
+      if (n < 0 && errno == EINTR){
+        continue;
+      }
+      if (n <= 0){
+        failed = true;
+        return;
+      }
+      data += n;
+      len -= n;
+    }
+  }
+};
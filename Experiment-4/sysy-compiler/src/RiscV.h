@@ -0,0 +1,748 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "koopa.h"
+#include "OutputBuffer.h"
+
+// 把 KoopaRawBuilder 搭好的 raw program 翻译成 RV32IM 汇编
+//
+// 栈帧 (从 sp 往上):
+//   第 9 个以后的实参 | 局部变量和放不进寄存器的值 | 保存的 s 寄存器 | ra
+// 只在一个基本块里用到的值按块内线性扫描分配寄存器:
+//   生命期里没有 call 的优先用 t3-t6, 否则用 s0-s11 (在序言里保存)
+//   跨基本块的值和分不到寄存器的值放在栈上
+// t0 t1 用来取操作数, t2 用来算大偏移的地址
+class RiscVGen {
+ public:
+  OutputBuffer out;
+
+  void Generate(const koopa_raw_program_t &program) {
+    if (program.values.len){
+      out << "  .data\n";
+      for (uint32_t i = 0; i < program.values.len; i++){
+        Dump_Global((koopa_raw_value_t) program.values.buffer[i]);
+      }
+      out << '\n';
+    }
+    for (uint32_t i = 0; i < program.funcs.len; i++){
+      auto func = (koopa_raw_function_t) program.funcs.buffer[i];
+      // 运行时库只有声明, 由链接器提供
+      if (func->bbs.len){
+        Dump_Function(func);
+      }
+    }
+  }
+
+ private:
+  // 值放在哪里
+  typedef struct{
+    enum Kind : uint8_t { None, Reg, Stack, Fused };
+    Kind kind;
+    int reg;        // Reg: regs[] 的下标
+    int offset;     // Stack: 相对 sp 的偏移
+  } Home;
+
+  // 可分配的寄存器, 前 4 个是调用者保存的
+  static const int kTempRegs = 4;
+  static const int kRegCount = 16;
+  static constexpr const char *regs[kRegCount] = {
+    "t3", "t4", "t5", "t6",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11",
+  };
+  static constexpr const char *arg_regs[8] = {"a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7"};
+
+  // 条件跳转只能跳 4KiB, 估计出来的距离超过这个值就绕一下用 j
+  static const int kBranchRange = 4000;
+
+  // 当前函数
+  const char *func_name;
+  std::unordered_map<koopa_raw_value_t, Home> homes;
+  std::unordered_map<koopa_raw_value_t, int> arg_slots;
+  std::unordered_map<koopa_raw_basic_block_t, int> block_bytes;
+  std::vector<int> inst_bytes;
+  int frame_size = 0;
+  bool has_call = false;
+  bool saved[kRegCount];
+  // 入口块里第一个 call 之前, 形参还在 a0-a7 里
+  bool args_in_regs = false;
+  int skip_count = 0;
+
+  // ---------- 全局变量 ----------
+
+  static int Type_Size(koopa_raw_type_t ty) {
+    switch (ty->tag){
+      case KOOPA_RTT_ARRAY: return (int) ty->data.array.len * Type_Size(ty->data.array.base);
+      case KOOPA_RTT_UNIT: return 0;
+      default: return 4;
+    }
+  }
+
+  // 去掉 raw 名字前面的 @ / %
+  static const char *Asm_Name(const char *name) {
+    return name + 1;
+  }
+
+  void Dump_Global(koopa_raw_value_t v) {
+    const char *name = Asm_Name(v->name);
+    out << "  .globl " << name << '\n' << name << ":\n";
+    koopa_raw_value_t init = v->kind.data.global_alloc.init;
+    if (init->kind.tag == KOOPA_RVT_ZERO_INIT){
+      out << "  .zero " << Type_Size(init->ty) << '\n';
+      return;
+    }
+    // 连续的 0 合并成一条 .zero
+    std::vector<int> words;
+    Flatten(init, words);
+    size_t i = 0;
+    while (i < words.size()){
+      if (words[i]){
+        out << "  .word " << words[i++] << '\n';
+        continue;
+      }
+      size_t j = i;
+      while (j < words.size() && !words[j]){
+        j++;
+      }
+      out << "  .zero " << (int) (j - i) * 4 << '\n';
+      i = j;
+    }
+  }
+
+  static void Flatten(koopa_raw_value_t v, std::vector<int> &words) {
+    switch (v->kind.tag){
+      case KOOPA_RVT_INTEGER:
+        words.push_back(v->kind.data.integer.value);
+        break;
+      case KOOPA_RVT_AGGREGATE:
+        for (uint32_t i = 0; i < v->kind.data.aggregate.elems.len; i++){
+          Flatten((koopa_raw_value_t) v->kind.data.aggregate.elems.buffer[i], words);
+        }
+        break;
+      default:
+        words.insert(words.end(), Type_Size(v->ty) / 4, 0);
+        break;
+    }
+  }
+
+  // ---------- 栈帧和寄存器分配 ----------
+
+  static koopa_raw_basic_block_t Block(koopa_raw_function_t func, uint32_t i) {
+    return (koopa_raw_basic_block_t) func->bbs.buffer[i];
+  }
+
+  static koopa_raw_value_t Inst(koopa_raw_basic_block_t bb, uint32_t i) {
+    return (koopa_raw_value_t) bb->insts.buffer[i];
+  }
+
+  static bool Is_Compare(koopa_raw_binary_op_t op) {
+    return op <= KOOPA_RBO_LE;
+  }
+
+  // 一条 IR 指令最多能展开成多少字节, 用来估计跳转距离
+  static int Max_Bytes(koopa_raw_value_t v) {
+    if (v->kind.tag == KOOPA_RVT_CALL){
+      return 64 + 16 * (int) v->kind.data.call.args.len;
+    }
+    if (v->kind.tag == KOOPA_RVT_RETURN){
+      return 64 + 12 * (kRegCount + 1);
+    }
+    return 64;
+  }
+
+  void Allocate(koopa_raw_function_t func) {
+    homes.clear();
+    arg_slots.clear();
+    block_bytes.clear();
+    inst_bytes.clear();
+    has_call = false;
+    for (int r = 0; r < kRegCount; r++){
+      saved[r] = false;
+    }
+
+    // 每条指令在哪个块的第几条
+    std::unordered_map<koopa_raw_value_t, std::pair<uint32_t, uint32_t>> pos;
+    int out_args = 0;
+    int bytes = 0;
+    uint32_t first_call = UINT32_MAX;
+    for (uint32_t b = 0; b < func->bbs.len; b++){
+      koopa_raw_basic_block_t bb = Block(func, b);
+      block_bytes[bb] = bytes;
+      for (uint32_t i = 0; i < bb->insts.len; i++){
+        koopa_raw_value_t v = Inst(bb, i);
+        pos[v] = {b, i};
+        inst_bytes.push_back(bytes);
+        bytes += Max_Bytes(v);
+        if (v->kind.tag == KOOPA_RVT_CALL){
+          has_call = true;
+          out_args = std::max(out_args, ((int) v->kind.data.call.args.len - 8) * 4);
+          if (b == 0 && first_call == UINT32_MAX){
+            first_call = i;
+          }
+        }
+      }
+    }
+
+    int locals = out_args;
+    auto new_slot = [&](int size){
+      int offset = locals;
+      locals += size;
+      return offset;
+    };
+
+    // 前 8 个形参在入口块第一个 call 之后还要用的话, 序言里先存到栈上
+    for (uint32_t i = 0; i < func->params.len && i < 8; i++){
+      auto param = (koopa_raw_value_t) func->params.buffer[i];
+      for (uint32_t u = 0; u < param->used_by.len; u++){
+        auto p = pos[(koopa_raw_value_t) param->used_by.buffer[u]];
+        if (p.first != 0 || p.second >= first_call){
+          arg_slots[param] = new_slot(4);
+          break;
+        }
+      }
+    }
+
+    for (uint32_t b = 0; b < func->bbs.len; b++){
+      koopa_raw_basic_block_t bb = Block(func, b);
+      std::vector<uint32_t> calls;
+      for (uint32_t i = 0; i < bb->insts.len; i++){
+        if (Inst(bb, i)->kind.tag == KOOPA_RVT_CALL){
+          calls.push_back(i);
+        }
+      }
+      // (最后一次使用的位置, 寄存器)
+      std::vector<std::pair<uint32_t, int>> active;
+      bool busy[kRegCount] = {};
+      for (uint32_t i = 0; i < bb->insts.len; i++){
+        koopa_raw_value_t v = Inst(bb, i);
+        for (size_t k = 0; k < active.size(); ){
+          if (active[k].first <= i){
+            busy[active[k].second] = false;
+            active[k] = active.back();
+            active.pop_back();
+          }else {
+            k++;
+          }
+        }
+
+        if (v->kind.tag == KOOPA_RVT_ALLOC){
+          homes[v] = {Home::Stack, 0, new_slot(Type_Size(v->ty->data.pointer.base))};
+          continue;
+        }
+        if (v->ty->tag == KOOPA_RTT_UNIT || !v->used_by.len){
+          continue;
+        }
+        // 紧挨着 br 的比较直接并进条件跳转
+        if (v->kind.tag == KOOPA_RVT_BINARY && Is_Compare(v->kind.data.binary.op) && v->used_by.len == 1
+            && i + 1 < bb->insts.len && v->used_by.buffer[0] == Inst(bb, i + 1)
+            && Inst(bb, i + 1)->kind.tag == KOOPA_RVT_BRANCH){
+          homes[v] = {Home::Fused, 0, 0};
+          continue;
+        }
+
+        bool local = true;
+        uint32_t last = i;
+        for (uint32_t u = 0; u < v->used_by.len; u++){
+          auto p = pos[(koopa_raw_value_t) v->used_by.buffer[u]];
+          if (p.first != b){
+            local = false;
+            break;
+          }
+          last = std::max(last, p.second);
+        }
+        int reg = -1;
+        if (local){
+          bool spans_call = false;
+          for (uint32_t c : calls){
+            spans_call = spans_call || (c > i && c < last);
+          }
+          for (int r = spans_call ? kTempRegs : 0; r < kRegCount && reg < 0; r++){
+            if (!busy[r]){
+              reg = r;
+            }
+          }
+        }
+        if (reg >= 0){
+          busy[reg] = true;
+          saved[reg] = saved[reg] || reg >= kTempRegs;
+          active.push_back({last, reg});
+          homes[v] = {Home::Reg, reg, 0};
+        }else {
+          homes[v] = {Home::Stack, 0, new_slot(4)};
+        }
+      }
+    }
+
+    int save_size = has_call ? 4 : 0;
+    for (int r = kTempRegs; r < kRegCount; r++){
+      save_size += saved[r] ? 4 : 0;
+    }
+    frame_size = (locals + save_size + 15) / 16 * 16;
+  }
+
+  // ---------- 指令输出的小工具 ----------
+
+  static bool Fits_Imm(int imm) {
+    return imm >= -2048 && imm <= 2047;
+  }
+
+  void Add_Imm(const char *rd, const char *rs, int imm) {
+    if (Fits_Imm(imm)){
+      if (imm || strcmp(rd, rs)){
+        out << "  addi " << rd << ", " << rs << ", " << imm << '\n';
+      }
+      return;
+    }
+    out << "  li t2, " << imm << '\n';
+    out << "  add " << rd << ", " << rs << ", t2\n";
+  }
+
+  // lw / sw 的偏移超过 12 位时先用 t2 算出地址
+  void Mem(const char *op, const char *reg, const char *base, int offset) {
+    if (!Fits_Imm(offset)){
+      Add_Imm("t2", base, offset);
+      base = "t2";
+      offset = 0;
+    }
+    out << "  " << op << ' ' << reg << ", " << offset << '(' << base << ")\n";
+  }
+
+  // 把 v 放进指定的寄存器
+  void Move_To(const char *reg, koopa_raw_value_t v) {
+    switch (v->kind.tag){
+      case KOOPA_RVT_INTEGER:
+        out << "  li " << reg << ", " << v->kind.data.integer.value << '\n';
+        return;
+      case KOOPA_RVT_GLOBAL_ALLOC:
+        out << "  la " << reg << ", " << Asm_Name(v->name) << '\n';
+        return;
+      case KOOPA_RVT_ALLOC:
+        Add_Imm(reg, "sp", homes[v].offset);
+        return;
+      case KOOPA_RVT_FUNC_ARG_REF: {
+        size_t index = v->kind.data.func_arg_ref.index;
+        if (index >= 8){
+          // 调用者放在它自己栈帧的最底下
+          Mem("lw", reg, "sp", frame_size + (int) (index - 8) * 4);
+        }else if (args_in_regs){
+          out << "  mv " << reg << ", " << arg_regs[index] << '\n';
+        }else {
+          Mem("lw", reg, "sp", arg_slots[v]);
+        }
+        return;
+      }
+      default:
+        break;
+    }
+    const Home &home = homes[v];
+    if (home.kind == Home::Reg){
+      if (strcmp(reg, regs[home.reg])){
+        out << "  mv " << reg << ", " << regs[home.reg] << '\n';
+      }
+    }else {
+      Mem("lw", reg, "sp", home.offset);
+    }
+  }
+
+  // 取操作数: 已经在寄存器里的直接用, 否则放进 scratch
+  const char *Use(koopa_raw_value_t v, const char *scratch) {
+    if (v->kind.tag == KOOPA_RVT_INTEGER && v->kind.data.integer.value == 0){
+      return "x0";
+    }
+    if (v->kind.tag == KOOPA_RVT_FUNC_ARG_REF && args_in_regs && v->kind.data.func_arg_ref.index < 8){
+      return arg_regs[v->kind.data.func_arg_ref.index];
+    }
+    auto it = homes.find(v);
+    if (it != homes.end() && it->second.kind == Home::Reg){
+      return regs[it->second.reg];
+    }
+    Move_To(scratch, v);
+    return scratch;
+  }
+
+  // 结果先算到哪个寄存器
+  const char *Dest(koopa_raw_value_t v) {
+    auto it = homes.find(v);
+    if (it != homes.end() && it->second.kind == Home::Reg){
+      return regs[it->second.reg];
+    }
+    return "t0";
+  }
+
+  // 栈上的值写回去, 没人用的结果直接丢掉
+  void Save(koopa_raw_value_t v, const char *reg) {
+    auto it = homes.find(v);
+    if (it != homes.end() && it->second.kind == Home::Stack){
+      Mem("sw", reg, "sp", it->second.offset);
+    }
+  }
+
+  void Print_Label(koopa_raw_basic_block_t bb) {
+    out << ".L" << func_name << '.' << Asm_Name(bb->name);
+  }
+
+  // 目标离当前指令足够近时才能直接用条件跳转
+  bool Near(koopa_raw_basic_block_t target, int inst_index) {
+    int distance = abs(block_bytes[target] - inst_bytes[inst_index]) + 64;
+    return distance < kBranchRange;
+  }
+
+  static const char *Branch_Op(koopa_raw_binary_op_t op, bool negate) {
+    switch (op){
+      case KOOPA_RBO_EQ: return negate ? "bne" : "beq";
+      case KOOPA_RBO_NOT_EQ: return negate ? "beq" : "bne";
+      case KOOPA_RBO_LT: return negate ? "bge" : "blt";
+      case KOOPA_RBO_GE: return negate ? "blt" : "bge";
+      case KOOPA_RBO_GT: return negate ? "ble" : "bgt";
+      case KOOPA_RBO_LE: return negate ? "bgt" : "ble";
+      default: return "";
+    }
+  }
+
+  // 条件成立时跳到 target, 太远就反过来跳过一条 j
+  void Branch_To(koopa_raw_binary_op_t op, bool negate, const char *lhs, const char *rhs,
+                 koopa_raw_basic_block_t target, int inst_index) {
+    if (Near(target, inst_index)){
+      out << "  " << Branch_Op(op, negate) << ' ' << lhs << ", " << rhs << ", ";
+      Print_Label(target);
+      out << '\n';
+      return;
+    }
+    int skip = skip_count++;
+    out << "  " << Branch_Op(op, !negate) << ' ' << lhs << ", " << rhs << ", .Lskip_" << skip << '\n';
+    out << "  j ";
+    Print_Label(target);
+    out << "\n.Lskip_" << skip << ":\n";
+  }
+
+  // ---------- 函数 ----------
+
+  void Dump_Function(koopa_raw_function_t func) {
+    func_name = Asm_Name(func->name);
+    Allocate(func);
+
+    out << "  .text\n  .globl " << func_name << '\n' << func_name << ":\n";
+    if (frame_size){
+      Add_Imm("sp", "sp", -frame_size);
+    }
+    int offset = frame_size;
+    if (has_call){
+      offset -= 4;
+      Mem("sw", "ra", "sp", offset);
+    }
+    for (int r = kTempRegs; r < kRegCount; r++){
+      if (saved[r]){
+        offset -= 4;
+        Mem("sw", regs[r], "sp", offset);
+      }
+    }
+    for (auto &slot : arg_slots){
+      Mem("sw", arg_regs[slot.first->kind.data.func_arg_ref.index], "sp", slot.second);
+    }
+
+    int index = 0;
+    for (uint32_t b = 0; b < func->bbs.len; b++){
+      koopa_raw_basic_block_t bb = Block(func, b);
+      koopa_raw_basic_block_t next = b + 1 < func->bbs.len ? Block(func, b + 1) : NULL;
+      args_in_regs = b == 0;
+      if (b){
+        Print_Label(bb);
+        out << ":\n";
+      }
+      for (uint32_t i = 0; i < bb->insts.len; i++){
+        Dump_Inst(Inst(bb, i), next, index++);
+      }
+    }
+    out << '\n';
+  }
+
+  void Dump_Epilogue() {
+    int offset = frame_size;
+    if (has_call){
+      offset -= 4;
+      Mem("lw", "ra", "sp", offset);
+    }
+    for (int r = kTempRegs; r < kRegCount; r++){
+      if (saved[r]){
+        offset -= 4;
+        Mem("lw", regs[r], "sp", offset);
+      }
+    }
+    if (frame_size){
+      Add_Imm("sp", "sp", frame_size);
+    }
+    out << "  ret\n";
+  }
+
+  void Dump_Inst(koopa_raw_value_t v, koopa_raw_basic_block_t next, int index) {
+    const auto &d = v->kind.data;
+    switch (v->kind.tag){
+      case KOOPA_RVT_ALLOC:
+        break;
+      case KOOPA_RVT_LOAD:
+        Dump_Load(v);
+        break;
+      case KOOPA_RVT_STORE:
+        Dump_Store(v);
+        break;
+      case KOOPA_RVT_GET_PTR:
+        Dump_Get_Ptr(v, d.get_ptr.src, d.get_ptr.index, d.get_ptr.src->ty->data.pointer.base);
+        break;
+      case KOOPA_RVT_GET_ELEM_PTR:
+        Dump_Get_Ptr(v, d.get_elem_ptr.src, d.get_elem_ptr.index,
+                     d.get_elem_ptr.src->ty->data.pointer.base->data.array.base);
+        break;
+      case KOOPA_RVT_BINARY:
+        if (homes[v].kind != Home::Fused){
+          Dump_Binary(v);
+        }
+        break;
+      case KOOPA_RVT_BRANCH:
+        Dump_Branch(v, next, index);
+        break;
+      case KOOPA_RVT_JUMP:
+        if (d.jump.target != next){
+          out << "  j ";
+          Print_Label(d.jump.target);
+          out << '\n';
+        }
+        break;
+      case KOOPA_RVT_CALL:
+        Dump_Call(v);
+        break;
+      case KOOPA_RVT_RETURN:
+        if (d.ret.value){
+          Move_To("a0", d.ret.value);
+        }
+        Dump_Epilogue();
+        break;
+      default:
+        break;
+    }
+  }
+
+  void Dump_Load(koopa_raw_value_t v) {
+    koopa_raw_value_t src = v->kind.data.load.src;
+    const char *rd = Dest(v);
+    if (src->kind.tag == KOOPA_RVT_ALLOC){
+      Mem("lw", rd, "sp", homes[src].offset);
+    }else if (src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
+      out << "  lui t2, %hi(" << Asm_Name(src->name) << ")\n";
+      out << "  lw " << rd << ", %lo(" << Asm_Name(src->name) << ")(t2)\n";
+    }else {
+      out << "  lw " << rd << ", 0(" << Use(src, "t0") << ")\n";
+    }
+    Save(v, rd);
+  }
+
+  void Dump_Store(koopa_raw_value_t v) {
+    koopa_raw_value_t dest = v->kind.data.store.dest;
+    const char *value = Use(v->kind.data.store.value, "t0");
+    if (dest->kind.tag == KOOPA_RVT_ALLOC){
+      Mem("sw", value, "sp", homes[dest].offset);
+    }else if (dest->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
+      out << "  lui t2, %hi(" << Asm_Name(dest->name) << ")\n";
+      out << "  sw " << value << ", %lo(" << Asm_Name(dest->name) << ")(t2)\n";
+    }else {
+      out << "  sw " << value << ", 0(" << Use(dest, "t1") << ")\n";
+    }
+  }
+
+  // getptr / getelemptr: src + index * sizeof(elem), 常量下标直接并进偏移
+  void Dump_Get_Ptr(koopa_raw_value_t v, koopa_raw_value_t src, koopa_raw_value_t index, koopa_raw_type_t elem) {
+    int stride = Type_Size(elem);
+    const char *rd = Dest(v);
+    if (index->kind.tag == KOOPA_RVT_INTEGER){
+      int offset = index->kind.data.integer.value * stride;
+      if (src->kind.tag == KOOPA_RVT_ALLOC){
+        Add_Imm(rd, "sp", homes[src].offset + offset);
+      }else {
+        Add_Imm(rd, Use(src, "t0"), offset);
+      }
+      Save(v, rd);
+      return;
+    }
+    const char *base = Use(src, "t0");
+    const char *i = Use(index, "t1");
+    int shift = Log2(stride);
+    if (shift >= 0){
+      out << "  slli t1, " << i << ", " << shift << '\n';
+    }else {
+      out << "  li t2, " << stride << '\n';
+      out << "  mul t1, " << i << ", t2\n";
+    }
+    out << "  add " << rd << ", " << base << ", t1\n";
+    Save(v, rd);
+  }
+
+  static int Log2(int x) {
+    if (x <= 0 || (x & (x - 1))){
+      return -1;
+    }
+    int k = 0;
+    while ((1 << k) != x){
+      k++;
+    }
+    return k;
+  }
+
+  void Dump_Binary(koopa_raw_value_t v) {
+    const auto &bin = v->kind.data.binary;
+    const char *rd = Dest(v);
+    const char *lhs = Use(bin.lhs, "t0");
+    if (bin.rhs->kind.tag == KOOPA_RVT_INTEGER && Dump_Binary_Imm(bin.op, rd, lhs, bin.rhs->kind.data.integer.value)){
+      Save(v, rd);
+      return;
+    }
+    const char *rhs = Use(bin.rhs, "t1");
+    switch (bin.op){
+      case KOOPA_RBO_NOT_EQ:
+        out << "  xor " << rd << ", " << lhs << ", " << rhs << '\n';
+        out << "  snez " << rd << ", " << rd << '\n';
+        break;
+      case KOOPA_RBO_EQ:
+        out << "  xor " << rd << ", " << lhs << ", " << rhs << '\n';
+        out << "  seqz " << rd << ", " << rd << '\n';
+        break;
+      case KOOPA_RBO_GT:
+        out << "  sgt " << rd << ", " << lhs << ", " << rhs << '\n';
+        break;
+      case KOOPA_RBO_LT:
+        out << "  slt " << rd << ", " << lhs << ", " << rhs << '\n';
+        break;
+      case KOOPA_RBO_GE:
+        out << "  slt " << rd << ", " << lhs << ", " << rhs << '\n';
+        out << "  xori " << rd << ", " << rd << ", 1\n";
+        break;
+      case KOOPA_RBO_LE:
+        out << "  sgt " << rd << ", " << lhs << ", " << rhs << '\n';
+        out << "  xori " << rd << ", " << rd << ", 1\n";
+        break;
+      default:
+        out << "  " << Reg_Op(bin.op) << ' ' << rd << ", " << lhs << ", " << rhs << '\n';
+        break;
+    }
+    Save(v, rd);
+  }
+
+  // 右操作数是 12 位立即数时用 I 型指令, 乘 2 的幂用移位; 不合适时返回 false
+  bool Dump_Binary_Imm(koopa_raw_binary_op_t op, const char *rd, const char *lhs, int imm) {
+    switch (op){
+      case KOOPA_RBO_ADD:
+        if (!Fits_Imm(imm)){
+          return false;
+        }
+        out << "  addi " << rd << ", " << lhs << ", " << imm << '\n';
+        return true;
+      case KOOPA_RBO_SUB:
+        if (imm == INT_MIN || !Fits_Imm(-imm)){
+          return false;
+        }
+        out << "  addi " << rd << ", " << lhs << ", " << -imm << '\n';
+        return true;
+      case KOOPA_RBO_MUL: {
+        int shift = Log2(imm);
+        if (shift < 0){
+          return false;
+        }
+        out << "  slli " << rd << ", " << lhs << ", " << shift << '\n';
+        return true;
+      }
+      case KOOPA_RBO_AND:
+      case KOOPA_RBO_OR:
+      case KOOPA_RBO_XOR:
+      case KOOPA_RBO_LT:
+        if (!Fits_Imm(imm)){
+          return false;
+        }
+        out << "  " << Reg_Op(op) << "i " << rd << ", " << lhs << ", " << imm << '\n';
+        return true;
+      case KOOPA_RBO_EQ:
+      case KOOPA_RBO_NOT_EQ: {
+        const char *set = op == KOOPA_RBO_EQ ? "seqz" : "snez";
+        if (imm){
+          if (!Fits_Imm(imm)){
+            return false;
+          }
+          out << "  xori " << rd << ", " << lhs << ", " << imm << '\n';
+          lhs = rd;
+        }
+        out << "  " << set << ' ' << rd << ", " << lhs << '\n';
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  static const char *Reg_Op(koopa_raw_binary_op_t op) {
+    switch (op){
+      case KOOPA_RBO_ADD: return "add";
+      case KOOPA_RBO_SUB: return "sub";
+      case KOOPA_RBO_MUL: return "mul";
+      case KOOPA_RBO_DIV: return "div";
+      case KOOPA_RBO_MOD: return "rem";
+      case KOOPA_RBO_AND: return "and";
+      case KOOPA_RBO_OR: return "or";
+      case KOOPA_RBO_XOR: return "xor";
+      case KOOPA_RBO_SHL: return "sll";
+      case KOOPA_RBO_SHR: return "srl";
+      case KOOPA_RBO_SAR: return "sra";
+      case KOOPA_RBO_LT: return "slt";
+      default: return "";
+    }
+  }
+
+  // 紧挨着的下一个块不用跳
+  void Dump_Branch(koopa_raw_value_t v, koopa_raw_basic_block_t next, int index) {
+    const auto &br = v->kind.data.branch;
+    koopa_raw_binary_op_t op = KOOPA_RBO_NOT_EQ;
+    const char *lhs, *rhs = "x0";
+    if (homes.count(br.cond) && homes[br.cond].kind == Home::Fused){
+      op = br.cond->kind.data.binary.op;
+      lhs = Use(br.cond->kind.data.binary.lhs, "t0");
+      rhs = Use(br.cond->kind.data.binary.rhs, "t1");
+    }else {
+      lhs = Use(br.cond, "t0");
+    }
+    if (br.true_bb == next){
+      Branch_To(op, true, lhs, rhs, br.false_bb, index);
+      return;
+    }
+    Branch_To(op, false, lhs, rhs, br.true_bb, index);
+    if (br.false_bb != next){
+      out << "  j ";
+      Print_Label(br.false_bb);
+      out << '\n';
+    }
+  }
+
+  // 前 8 个参数放 a0-a7, 其余的从 sp 开始往上放
+  void Dump_Call(koopa_raw_value_t v) {
+    const auto &call = v->kind.data.call;
+    args_in_regs = false;
+    for (uint32_t i = 0; i < call.args.len; i++){
+      auto arg = (koopa_raw_value_t) call.args.buffer[i];
+      if (i < 8){
+        Move_To(arg_regs[i], arg);
+      }else {
+        Mem("sw", Use(arg, "t0"), "sp", (int) (i - 8) * 4);
+      }
+    }
+    out << "  call " << Asm_Name(call.callee->name) << '\n';
+    auto it = homes.find(v);
+    if (it == homes.end()){
+      return;
+    }
+    if (it->second.kind == Home::Reg){
+      out << "  mv " << regs[it->second.reg] << ", a0\n";
+    }else {
+      Save(v, "a0");
+    }
+  }
+};
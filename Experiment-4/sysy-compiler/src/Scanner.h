@@ -0,0 +1,283 @@
+#pragma once
+
+// 由 sysy.l 在 sysy.tab.hpp 之后引入, 要用到 bison 的 token 编号, YYSTYPE 和 Compilation
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "Skip.h"
+
+void print_error(const std::string &msg, const char *token, int line);
+int lex_int_literal(Compilation &c, YYSTYPE *lval, int line, const char *text, size_t len);
+
+// 字符分类
+enum : uint8_t { kScanOther, kScanSpace, kScanIdent, kScanDigit, kScanOp };
+
+static constexpr std::array<uint8_t, 256> Scanner_Make_Class() {
+  std::array<uint8_t, 256> t{};
+  t[' '] = t['\t'] = t['\n'] = t['\r'] = kScanSpace;
+  for (int c = 'a'; c <= 'z'; c++){
+    t[c] = t[c - 'a' + 'A'] = kScanIdent;
+  }
+  t['_'] = kScanIdent;
+  for (int c = '0'; c <= '9'; c++){
+    t[c] = kScanDigit;
+  }
+  for (const char *c = "+-*/%=;,(){}[]<>!&|"; *c; c++){
+    t[(uint8_t) *c] = kScanOp;
+  }
+  return t;
+}
+
+static constexpr std::array<bool, 256> Scanner_Make_Ident_Char() {
+  std::array<bool, 256> t{};
+  for (int c = 0; c < 256; c++){
+    t[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+  }
+  return t;
+}
+
+// ---------- 运算符 ----------
+
+// token 为 0 的字符不能单独出现 (& 和 |)
+typedef struct{
+  int token;
+  const char *name;
+  const char *text;
+  char second;
+  int token2;
+  const char *name2;
+  const char *text2;
+} ScannerOp;
+
+static constexpr std::array<ScannerOp, 256> Scanner_Make_Ops() {
+  std::array<ScannerOp, 256> t{};
+  t['+'] = {ADD, "ADD", "+", 0, 0, NULL, NULL};
+  t['-'] = {SUB, "SUB", "-", 0, 0, NULL, NULL};
+  t['*'] = {MUL, "MUL", "*", 0, 0, NULL, NULL};
+  t['/'] = {DIV, "DIV", "/", 0, 0, NULL, NULL};
+  t['%'] = {MOD, "MOD", "%", 0, 0, NULL, NULL};
+  t[';'] = {SEMI, "SEMI", ";", 0, 0, NULL, NULL};
+  t[','] = {COMMA, "COMMA", ",", 0, 0, NULL, NULL};
+  t['('] = {LPAREN, "LPAREN", "(", 0, 0, NULL, NULL};
+  t[')'] = {RPAREN, "RPAREN", ")", 0, 0, NULL, NULL};
+  t['{'] = {LBRACE, "LBRACE", "{", 0, 0, NULL, NULL};
+  t['}'] = {RBRACE, "RBRACE", "}", 0, 0, NULL, NULL};
+  t['['] = {LBRACKET, "LBRACKET", "[", 0, 0, NULL, NULL};
+  t[']'] = {RBRACKET, "RBRACKET", "]", 0, 0, NULL, NULL};
+  t['='] = {ASSIGN, "ASSIGN", "=", '=', EQ, "EQ", "=="};
+  t['<'] = {'<', "LT", "<", '=', LE, "LE", "<="};
+  t['>'] = {'>', "GT", ">", '=', GE, "GE", ">="};
+  t['!'] = {'!', "NOT", "!", '=', NE, "NE", "!="};
+  t['&'] = {0, NULL, NULL, '&', AND, "AND", "&&"};
+  t['|'] = {0, NULL, NULL, '|', OR, "OR", "||"};
+  return t;
+}
+
+// ---------- 关键字 ----------
+
+typedef struct{
+  const char *text;
+  uint8_t len;
+  int token;
+  const char *name;
+} ScannerKeyword;
+
+static const int kKeywordSlots = 16;
+
+// 对这 10 个关键字没有冲突的哈希: 首字母, 尾字母和长度
+static constexpr unsigned Scanner_Keyword_Hash(const char *s, size_t len) {
+  return ((uint8_t) s[0] * 6u + (uint8_t) s[len - 1] * 3u + (unsigned) len) & (kKeywordSlots - 1);
+}
+
+static constexpr std::array<ScannerKeyword, kKeywordSlots> Scanner_Make_Keywords() {
+  const ScannerKeyword list[] = {
+    {"if", 2, IF, "IF"},
+    {"then", 4, THEN, "THEN"},
+    {"else", 4, ELSE, "ELSE"},
+    {"while", 5, WHILE, "WHILE"},
+    {"break", 5, BREAK, "BREAK"},
+    {"continue", 8, CONTINUE, "CONTINUE"},
+    {"int", 3, INT, "INT"},
+    {"return", 6, RETURN, "RETURN"},
+    {"const", 5, CONST, "CONST"},
+    {"void", 4, VOID, "VOID"},
+  };
+  std::array<ScannerKeyword, kKeywordSlots> t{};
+  for (const ScannerKeyword &kw : list){
+    t[Scanner_Keyword_Hash(kw.text, kw.len)] = kw;
+  }
+  return t;
+}
+
+static constexpr int Scanner_Keyword_Count() {
+  int n = 0;
+  for (const ScannerKeyword &kw : Scanner_Make_Keywords()){
+    n += kw.text != NULL;
+  }
+  return n;
+}
+
+static_assert(Scanner_Keyword_Count() == 10, "keyword hash has collisions");
+
+// 手写的扫描器, 和 flex 生成的 DFA 识别同样的 token, 输出同样的 -lex 结果
+// 直接在 SourceFile 映射的内存上走指针, 依赖结尾的 '\0' 作为哨兵
+// 关键字用编译期算好的完美哈希, 字符分类和运算符都查表
+// 行号和 token 文本自己维护, 不经过 flex 的 yylineno / yytext
+class Scanner {
+ public:
+  explicit Scanner(Compilation &c) : c(c) {}
+
+  void Reset(const char *data, size_t size) {
+    p = data;
+    end = data + size;
+    line = 1;
+  }
+
+  int Next(YYSTYPE *lval) {
+    // 非法字符报错之后跳过, 接着找下一个 token
+    int t;
+    while ((t = Scan(lval)) < 0){
+    }
+    return t;
+  }
+
+  // 扫描一个 token, 返回 token 编号, 输入结束返回 0, 非法字符报错后返回 -1
+  int Scan(YYSTYPE *lval) {
+    for (;;){
+      if (kClass[(uint8_t) *p] == kScanSpace){
+        p = Skip_Blank(p, end, line);
+      }
+      if (p[0] == '/' && p[1] == '/'){
+        p = Skip_Line(p + 2, end);
+        continue;
+      }
+      if (p[0] == '/' && p[1] == '*'){
+        const char *close = Skip_Block_Comment(p + 2, end, line);
+        // 没有结尾的 "/*" 和 flex 一样当成 '/' 和 '*'
+        if (close){
+          p = close;
+          continue;
+        }
+      }
+      break;
+    }
+    if (p >= end){
+      // 和 flex 一样, 结尾的 token 文本是空串
+      Set_Text(p, 0);
+      return 0;
+    }
+
+    const char *start = p;
+    token = start;
+    switch (kClass[(uint8_t) *p]){
+      case kScanIdent: {
+        do {
+          p++;
+        } while (kIdentChar[(uint8_t) *p]);
+        size_t len = p - start;
+        Set_Text(start, len);
+        const ScannerKeyword *kw = Find_Keyword(start, len);
+        if (kw){
+          c.Print_Token(kw->name, kw->text);
+          return kw->token;
+        }
+        lval->sym_val = c.interner.Intern(start, len);
+        c.Print_Token("IDENT", c.interner.Str(lval->sym_val));
+        return IDENT;
+      }
+      case kScanDigit:
+        return Number(lval);
+      case kScanOp: {
+        // 第二个字符对上了就是双字符运算符, 否则是单字符
+        const ScannerOp &op = kOps[(uint8_t) *p];
+        bool two = op.second && p[1] == op.second;
+        const char *name = two ? op.name2 : op.name;
+        const char *text = two ? op.text2 : op.text;
+        int token = two ? op.token2 : op.token;
+        if (!token){
+          break;
+        }
+        p += 1 + two;
+        Set_Text(start, p - start);
+        c.Print_Token(name, text);
+        return token;
+      }
+      default:
+        break;
+    }
+    Set_Text(start, 1);
+    print_error("Invalid characterat", Text(), line);
+    p = start + 1;
+    return -1;
+  }
+
+  // 最近一个 token 在输入里的开头
+  const char *Token() const {
+    return token;
+  }
+
+  // 最近一个 token 的文本, yyerror 报错时要用
+  const char *Text() const {
+    return text.c_str();
+  }
+
+  int Line() const {
+    return line;
+  }
+
+ private:
+  Compilation &c;
+  const char *p = NULL;
+  const char *end = NULL;
+  const char *token = NULL;
+  int line = 1;
+  std::string text;
+
+  static constexpr std::array<uint8_t, 256> kClass = Scanner_Make_Class();
+  static constexpr std::array<bool, 256> kIdentChar = Scanner_Make_Ident_Char();
+  static constexpr std::array<ScannerOp, 256> kOps = Scanner_Make_Ops();
+  static constexpr std::array<ScannerKeyword, kKeywordSlots> kKeywords = Scanner_Make_Keywords();
+
+  static const ScannerKeyword *Find_Keyword(const char *s, size_t len) {
+    if (len < 2 || len > 8){
+      return NULL;
+    }
+    const ScannerKeyword &kw = kKeywords[Scanner_Keyword_Hash(s, len)];
+    if (kw.len == len && memcmp(kw.text, s, len) == 0){
+      return &kw;
+    }
+    return NULL;
+  }
+
+  // ---------- 整数字面量, 范围和 sysy.l 的三条规则一致, 解码交给 lex_int_literal ----------
+
+  int Number(YYSTYPE *lval) {
+    const char *start = p;
+    if (*p != '0'){
+      // Decimal: [1-9][0-9]*
+      do {
+        p++;
+      } while (kClass[(uint8_t) *p] == kScanDigit);
+    }else {
+      // Hexadecimal: 0[xX][a-zA-Z0-9]+, Octal: 0[a-zA-Z0-9]*
+      bool hex = (p[1] == 'x' || p[1] == 'X') && Is_Alnum(p[2]);
+      p += hex ? 3 : 1;
+      while (Is_Alnum(*p)){
+        p++;
+      }
+    }
+    Set_Text(start, p - start);
+    return lex_int_literal(c, lval, line, start, p - start);
+  }
+
+  static bool Is_Alnum(char c) {
+    return kIdentChar[(uint8_t) c] && c != '_';
+  }
+
+  void Set_Text(const char *start, size_t len) {
+    text.assign(start, len);
+  }
+};
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include "AST.h"
+#include "Compilation.h"
+
+// 语义分析: 重定义, 未定义, 变量和函数混用, 循环外的 break / continue, void 函数的调用当成值用
+// 用 ASTVisitor 编译期分派, 只处理下面这几种结点, 其余结点直接走过去
+
+// 在当前作用域声明变量, 同一作用域内重名则报错, loc 是定义处
+static void Declare_Variable(Sym ident, int type, Loc loc){
+  if (!ctx->symbol_table.vars.Declare(ident, {type, 0, 0})){
+    if (ctx->current_func_symbol_table == NULL){
+      ctx->Diag() << "Error: type B redefinition of global variable " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(loc) << std::endl;
+    }else {
+      ctx->Diag() << "Error: type B redefinition of variable " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(loc) << std::endl;
+    }
+    ctx->Fail(1);
+  }
+  if (ctx->current_func_symbol_table == NULL){
+    ctx->koopa.Reserve_Global_Name(ident);
+  }
+}
+
+// 表达式语句的整个表达式就是一次函数调用时 (外面可以套单孩子的结点, 括号和一元 '+'), 返回这个 UnaryExp
+// 只有这里的调用不用到返回值, 可以是 void 函数
+static const BaseAST *Statement_Call(const BaseAST *exp){
+  while (exp){
+    if (exp->kind == ASTKind::UnaryExp){
+      auto unary = (const UnaryExpAST *) exp;
+      if (unary->ident != kNoSym){
+        return exp;
+      }
+      // 一元 '+' 在折叠的表达式里不建结点, 这里也一样看穿它
+      if (unary->unary_exp && unary->unary_op != OpKind::Add){
+        return NULL;
+      }
+    }else if (exp->kind == ASTKind::LVal || exp->kind == ASTKind::Number || exp->kind == ASTKind::Expr){
+      return NULL;
+    }
+    if (exp->Child(1)){
+      return NULL;
+    }
+    exp = exp->Child(0);
+  }
+  return NULL;
+}
+
+class SemanticPass : public ASTVisitor<SemanticPass> {
+ public:
+  void Enter(const CompUnitAST *) {
+    // SysY 运行时库里的函数, 后 5 个是 void 函数
+    static const char *lib_funcs[] = {
+      "getint", "getch", "getarray", "putint", "putch", "putarray", "starttime", "stoptime",
+    };
+    for (const char *name : lib_funcs){
+      auto func = std::make_unique<func_symbol>();
+      func->is_void = name[0] != 'g';
+      ctx->symbol_table.func_symbol_map[ctx->interner.Intern(name, strlen(name))] = std::move(func);
+    }
+  }
+
+  void Enter(const FuncDefOrVarDeclAST *node) {
+    node->Set_Func_Type();
+  }
+
+  void Enter(const FuncDefAST_ *node) {
+    // redefinition check
+    if (ctx->symbol_table.func_symbol_map.find(node->ident) != ctx->symbol_table.func_symbol_map.end()){
+      ctx->Diag() << "Error: type B redefinition of function " << ctx->interner.Str(node->ident) << " at " << ctx->source_map.Decode(node->loc) << std::endl;
+      ctx->Fail(1);
+    }
+
+    ctx->symbol_table.func_symbol_map[node->ident] = std::make_unique<func_symbol>();
+    ctx->koopa.Reserve_Global_Name(node->ident);
+
+    ctx->current_func_symbol_table = ctx->symbol_table.func_symbol_map[node->ident].get();
+    ctx->current_func_symbol_table->block_end = 0;
+    ctx->current_func_symbol_table->is_void = node->func_type == "void";
+
+    // 形参单独一层作用域
+    ctx->symbol_table.vars.PushScope();
+  }
+  void Leave(const FuncDefAST_ *) {
+    ctx->symbol_table.vars.PopScope();
+    ctx->current_func_symbol_table = NULL;
+  }
+
+  // redefinition
+  void Enter(const ConstDefAST *node) {
+    Declare_Variable(node->ident, 1, node->loc);
+  }
+  void Enter(const VarDefAST *node) {
+    Declare_Variable(node->ident, 0, node->loc);
+  }
+  void Enter(const FuncFParamAST *node) {
+    Declare_Variable(node->ident, 0, node->loc);
+  }
+
+  void Enter(const BlockAST *) {
+    ctx->symbol_table.vars.PushScope();
+  }
+  void Leave(const BlockAST *) {
+    ctx->symbol_table.vars.PopScope();
+  }
+
+  void Enter(const StmtAST *node) {
+    switch (node->stmt_kind){
+      case StmtKind::While:
+        loop_depth ++;
+        break;
+      case StmtKind::Break:
+      case StmtKind::Continue:
+        if (loop_depth == 0){
+          ctx->Diag() << "Error: " << (node->stmt_kind == StmtKind::Break ? "break" : "continue") << " outside of a loop at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+          ctx->Fail(1);
+        }
+        break;
+      case StmtKind::Exp:
+        statement_call = Statement_Call(node->exp.get());
+        break;
+      default:
+        break;
+    }
+  }
+  void Leave(const StmtAST *node) {
+    if (node->stmt_kind == StmtKind::While){
+      loop_depth --;
+    }
+  }
+
+  void Enter(const LValAST *node) {
+    // undefinition
+    Sym ident = node->ident;
+    if (ctx->symbol_table.vars.Lookup(ident) == NULL){
+      if (ctx->current_func_symbol_table){
+        // use func as var
+        if (ctx->symbol_table.func_symbol_map.find(ident) != ctx->symbol_table.func_symbol_map.end()){
+          ctx->Diag() << "Error: type C use func as var: " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+          ctx->Fail(1);
+        }
+        ctx->Diag() << "Error: type A undefined variable " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+        ctx->Fail(1);
+      }
+      ctx->Diag() << "Error: type A undefined global variable " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+      ctx->Fail(1);
+    }
+  }
+
+  void Enter(const UnaryExpAST *node) {
+    // undefiniton check
+    Sym ident = node->ident;
+    if (ident != kNoSym){
+      if (ctx->symbol_table.func_symbol_map.find(ident) == ctx->symbol_table.func_symbol_map.end()){
+        // use var as func
+        if (ctx->symbol_table.vars.Lookup(ident) != NULL){
+          ctx->Diag() << "Error: type C use var as func: " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+          ctx->Fail(1);
+        }
+
+        ctx->Diag() << "Error: type A undefiniton of function " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+        ctx->Fail(1);
+      }
+      // void 函数没有值, 只能单独作为一条语句调用
+      if (ctx->symbol_table.func_symbol_map[ident]->is_void && node != statement_call){
+        ctx->Diag() << "Error: type C use void func as value: " << ctx->interner.Str(ident) << " at " << ctx->source_map.Decode(node->loc) << "." << std::endl;
+        ctx->Fail(1);
+      }
+    }
+  }
+
+ private:
+  // 当前在几层 while 里面
+  int loop_depth = 0;
+  // 当前表达式语句里不用返回值的那次调用, 见 Statement_Call
+  const BaseAST *statement_call = NULL;
+};
+
+// 对以 root 为根的整棵树做语义分析, 出错时报错并 Fail
+static void Semantic_Analysis(const BaseAST *root){
+  SemanticPass pass;
+  Walk_AST(root, pass);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 整个源文件映射到内存, flex 用 yy_scan_buffer 直接在上面扫描
+// yy_scan_buffer 要求缓冲区末尾有两个 '\0', 并且扫描时会临时改写缓冲区,
+// 所以用 MAP_PRIVATE 可写映射, 再在文件末尾后面垫一页匿名内存保证结尾是 0
+class SourceFile {
+ public:
+  ~SourceFile() {
+    Close();
+  }
+
+  bool Open(const char *name) {
+    Close();
+    int fd = open(name, O_RDONLY);
+    if (fd < 0){
+      return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && S_ISREG(st.st_mode)){
+      ok = Map(fd, st.st_size);
+    }else if (ok){
+      // 管道等不能 mmap 的输入, 退化成整块读进来
+      ok = Read(fd);
+    }
+    close(fd);
+    if (ok){
+      path = name;
+    }
+    return ok;
+  }
+
+  void Close() {
+    if (base && mapped){
+      munmap(base, map_size);
+    }else {
+      free(base);
+    }
+    base = NULL;
+    size = 0;
+    map_size = 0;
+    mapped = false;
+  }
+
+  // 源文件内容, 后面紧跟两个 '\0'
+  char *Data() const {
+    return base;
+  }
+
+  // 不包括结尾的两个 '\0'
+  size_t Size() const {
+    return size;
+  }
+
+  // 打开时给的路径, 报错和 SourceMap 用
+  const char *Path() const {
+    return path.c_str();
+  }
+
+  // pos 所在的列, 从 1 开始; 只在报错时用, 往回找上一个换行
+  size_t Column(const char *pos) const {
+    const char *line = pos;
+    while (line > base && line[-1] != '\n'){
+      line--;
+    }
+    return pos - line + 1;
+  }
+
+ private:
+  std::string path;
+  char *base = NULL;
+  size_t size = 0;
+  size_t map_size = 0;
+  bool mapped = false;
+
+  bool Map(int fd, size_t file_size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    map_size = (file_size + 2 + page - 1) / page * page;
+    void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED){
+      return false;
+    }
+    if (file_size && mmap(p, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+      munmap(p, map_size);
+      return false;
+    }
+    base = (char *) p;
+    size = file_size;
+    mapped = true;
+    return true;
+  }
+
+  bool Read(int fd) {
+    size_t cap = 1 << 16;
+    base = (char *) malloc(cap);
+    for (;;){
+      if (size + 2 >= cap){
+        cap *= 2;
+        base = (char *) realloc(base, cap);
+      }
+      ssize_t n = read(fd, base + size, cap - size - 2);
+      if (n < 0){
+        return false;
+      }
+      if (n == 0){
+        break;
+      }
+      size += n;
+    }
+    base[size] = base[size + 1] = '\0';
+    return true;
+  }
+};
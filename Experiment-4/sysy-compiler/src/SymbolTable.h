@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Intern.h"
+
+typedef struct{
+  int type;
+  int value;
+  int depth;
+}Symbol;
+
+// 带作用域的符号表
+// 开放寻址哈希表把 Sym 映射到它当前可见的那次声明,
+// 每次声明记一条 binding, 同名的外层声明挂在 shadowed 上 (影子链),
+// bindings 本身就是 undo log: 退出作用域时按声明的逆序弹出并恢复被遮住的声明
+class ScopedSymbolTable {
+ public:
+  ScopedSymbolTable() {
+    slots.assign(256, {kNoKey, kNone});
+    // 全局作用域
+    PushScope();
+  }
+
+  void PushScope() {
+    scope_marks.push_back(bindings.size());
+  }
+
+  void PopScope() {
+    uint32_t mark = scope_marks.back();
+    scope_marks.pop_back();
+    while (bindings.size() > mark){
+      const Binding &b = bindings.back();
+      FindSlot(b.ident)->binding = b.shadowed;
+      bindings.pop_back();
+    }
+  }
+
+  // 当前作用域的层数, 最外层 (全局) 为 0
+  int Depth() const {
+    return (int) scope_marks.size() - 1;
+  }
+
+  // 当前作用域里已经有同名声明时返回 false
+  bool Declare(Sym ident, Symbol symbol) {
+    Slot *slot = FindSlot(ident);
+    if (slot->key == kNoKey){
+      slot->key = ident;
+      slot->binding = kNone;
+      if (++used * 2 > slots.size()){
+        Grow();
+        slot = FindSlot(ident);
+      }
+    }
+    uint32_t top = slot->binding;
+    if (top != kNone && bindings[top].depth == Depth()){
+      return false;
+    }
+    symbol.depth = Depth();
+    bindings.push_back({ident, top, Depth(), symbol});
+    slot->binding = bindings.size() - 1;
+    return true;
+  }
+
+  // 由内向外查找, 找不到返回 NULL
+  Symbol *Lookup(Sym ident) {
+    uint32_t top = FindSlot(ident)->binding;
+    return top == kNone ? NULL : &bindings[top].symbol;
+  }
+
+  // 只查当前作用域
+  Symbol *LookupCurrent(Sym ident) {
+    uint32_t top = FindSlot(ident)->binding;
+    if (top == kNone || bindings[top].depth != Depth()){
+      return NULL;
+    }
+    return &bindings[top].symbol;
+  }
+
+ private:
+  static const uint32_t kNone = 0xffffffffu;
+  static const Sym kNoKey = 0xffffffffu;
+
+  struct Binding {
+    Sym ident;
+    uint32_t shadowed;
+    int depth;
+    Symbol symbol;
+  };
+
+  struct Slot {
+    Sym key;
+    uint32_t binding;
+  };
+
+  std::vector<Slot> slots;
+  size_t used = 0;
+  std::vector<Binding> bindings;
+  std::vector<uint32_t> scope_marks;
+
+  static size_t Hash(Sym ident) {
+    return (uint32_t) (ident * 2654435769u);
+  }
+
+  // 返回 ident 所在的槽, 没有则返回它应该插入的空槽
+  // 槽一旦占用就不再删除, 声明全部弹出后 binding 置为 kNone
+  Slot *FindSlot(Sym ident) {
+    size_t mask = slots.size() - 1;
+    for (size_t i = Hash(ident) & mask;; i = (i + 1) & mask){
+      if (slots[i].key == ident || slots[i].key == kNoKey){
+        return &slots[i];
+      }
+    }
+  }
+
+  void Grow() {
+    std::vector<Slot> old(slots.size() * 2, {kNoKey, kNone});
+    old.swap(slots);
+    for (const Slot &s : old){
+      if (s.key != kNoKey){
+        *FindSlot(s.key) = s;
+      }
+    }
+  }
+};
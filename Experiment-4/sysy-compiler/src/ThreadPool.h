@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -batch 用的 work-stealing 线程池
+// 任务是 0 .. n-1 的编号, 开始时轮流分给各个线程的队列, 线程先做自己队列里的,
+// 做完了就去别的队列尾部偷一半过来; 任务之间互不依赖, 也不会再产生新任务, 所以所有队列都空了就结束
+// 调用者把大文件排在前面, 轮流分配之后每个队列的工作量大致相当, 剩下的不均由偷任务抹平
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(unsigned workers) : queues(workers ? workers : 1) {
+    for (auto &q : queues){
+      q.reset(new Queue);
+    }
+  }
+
+  unsigned Workers() const {
+    return queues.size();
+  }
+
+  // 对每个任务调用 f(worker, task), 全部做完才返回, 调用线程自己当 0 号线程
+  template <typename F>
+  void Run(uint32_t tasks, F &&f) {
+    for (uint32_t i = 0; i < tasks; i++){
+      queues[i % queues.size()]->tasks.push_back(i);
+    }
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < queues.size(); w++){
+      threads.emplace_back([this, w, &f] { Work(w, f); });
+    }
+    Work(0, f);
+    for (auto &t : threads){
+      t.join();
+    }
+  }
+
+ private:
+  typedef struct{
+    std::mutex lock;
+    std::deque<uint32_t> tasks;
+  } Queue;
+
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  template <typename F>
+  void Work(unsigned w, F &f) {
+    uint32_t task;
+    while (Pop(w, task) || Steal(w, task)){
+      f(w, task);
+    }
+  }
+
+  // 自己的队列从头部取
+  bool Pop(unsigned w, uint32_t &task) {
+    Queue &q = *queues[w];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tasks.empty()){
+      return false;
+    }
+    task = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+  }
+
+  // 从下一个线程开始找, 偷走对方尾部的一半, 第一个直接返回, 其余放进自己的队列
+  bool Steal(unsigned w, uint32_t &task) {
+    std::vector<uint32_t> stolen;
+    for (unsigned i = 1; i < queues.size() && stolen.empty(); i++){
+      Queue &victim = *queues[(w + i) % queues.size()];
+      std::lock_guard<std::mutex> guard(victim.lock);
+      size_t n = (victim.tasks.size() + 1) / 2;
+      for (size_t k = 0; k < n; k++){
+        stolen.push_back(victim.tasks.back());
+        victim.tasks.pop_back();
+      }
+    }
+    if (stolen.empty()){
+      return false;
+    }
+    task = stolen.back();
+    stolen.pop_back();
+    Queue &q = *queues[w];
+    std::lock_guard<std::mutex> guard(q.lock);
+    q.tasks.insert(q.tasks.end(), stolen.rbegin(), stolen.rend());
+    return true;
+  }
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstring>
+#include "OutputBuffer.h"
+
+// -lex 模式的 token 输出, 每个 token 一行 "token: text"
+// 输出文件只打开一次, 由 OutputBuffer 攒成大块再写出
+class TokenSink {
+ public:
+  bool Open(const char *path) {
+    return out.Open(path);
+  }
+
+  bool IsOpen() const {
+    return out.IsOpen();
+  }
+
+  void Write(const char *token, const char *text) {
+    Write(token, strlen(token), text, strlen(text));
+  }
+
+  void Write(const char *token, size_t token_len, const char *text, size_t text_len) {
+    out.Write(token, token_len);
+    out.Write(": ", 2);
+    out.Write(text, text_len);
+    out << '\n';
+  }
+
+  void Write(const char *token, int value) {
+    out << token << ": " << value << '\n';
+  }
+
+  bool Flush() {
+    return out.Flush();
+  }
+
+  bool Close() {
+    return out.Close();
+  }
+
+ private:
+  OutputBuffer out;
+};
@@ -0,0 +1,319 @@
+#pragma once
+
+// 由 sysy.l 在 Scanner.h 之后引入, 要用到 bison 的 token 编号, YYSTYPE, Compilation 和 Scanner.h 里的运算符/关键字表
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Intern.h"
+#include "OutputBuffer.h"
+
+// -lex-bin 输出的二进制 token 流, 用来缓存词法分析的结果, 源文件没变时直接喂给 parser
+//
+// 文件头: "SYTK" 版本号 INT_CONST 的种类号 (语法改动导致 token 重新编号时旧缓存作废)
+//         varint 源文件长度, varint 源文件名长度和源文件名, 读回来时用它们登记 SourceMap
+// 每个 token:
+//   种类       varint, 0 表示结束
+//   行         varint, 和上一个 token 的行差
+//   偏移       varint, 和上一个 token 在源文件里的偏移差
+//   列         varint, 只在换行后出现, 绝对列 (从 1 开始), 同一行的列由偏移差推出
+//   IDENT      varint 流内编号, 等于当前已定义的个数时是新名字, 后面跟 varint 长度和名字本身
+//   INT_CONST  varint 32 位的值
+// varint 是 LEB128, 每字节低 7 位有效, 最高位为 1 表示后面还有
+
+static const char kTokenStreamMagic[4] = {'S', 'Y', 'T', 'K'};
+static const uint8_t kTokenStreamVersion = 2;
+
+// 种类号: bison 的 token 减去 YYerror, 单字符 token 和三种整数写法另外编号, 都小于 128 占一个字节
+enum : uint8_t {
+  kTokKindEnd = 0,
+  kTokKindLT = 64,
+  kTokKindGT,
+  kTokKindNot,
+  kTokKindHex,
+  kTokKindOctal,
+  kTokKindCount
+};
+
+static constexpr uint8_t Token_Stream_Kind(int token) {
+  switch (token){
+    case '<': return kTokKindLT;
+    case '>': return kTokKindGT;
+    case '!': return kTokKindNot;
+    default: return token - YYerror;
+  }
+}
+
+typedef struct{
+  int token;
+  const char *name;
+  const char *text;
+} TokenStreamName;
+
+// 种类号到 token 编号, -lex 输出的名字和文本, 名字和文本取自手写扫描器的表
+static constexpr std::array<TokenStreamName, kTokKindCount> Token_Stream_Make_Names() {
+  std::array<TokenStreamName, kTokKindCount> t{};
+  for (const ScannerOp &op : Scanner_Make_Ops()){
+    if (op.token){
+      t[Token_Stream_Kind(op.token)] = {op.token, op.name, op.text};
+    }
+    if (op.token2){
+      t[Token_Stream_Kind(op.token2)] = {op.token2, op.name2, op.text2};
+    }
+  }
+  for (const ScannerKeyword &kw : Scanner_Make_Keywords()){
+    if (kw.text){
+      t[Token_Stream_Kind(kw.token)] = {kw.token, kw.name, kw.text};
+    }
+  }
+  t[Token_Stream_Kind(IDENT)] = {IDENT, "IDENT", NULL};
+  t[Token_Stream_Kind(INT_CONST)] = {INT_CONST, "INT_CONST", NULL};
+  t[kTokKindHex] = {INT_CONST, "INT_CONST(Hexadecimal)", NULL};
+  t[kTokKindOctal] = {INT_CONST, "INT_CONST(Octal)", NULL};
+  return t;
+}
+
+static_assert(INT_CONST - YYerror < kTokKindLT, "token kinds overlap");
+
+static inline bool Is_Token_Stream(const char *data, size_t size) {
+  return size >= sizeof(kTokenStreamMagic) + 2 && memcmp(data, kTokenStreamMagic, sizeof(kTokenStreamMagic)) == 0;
+}
+
+// ---------- 写 ----------
+
+class TokenStreamWriter {
+ public:
+  explicit TokenStreamWriter(const StringInterner &interner) : interner(interner) {}
+
+  bool Open(const char *path, const char *source_name, size_t source_size) {
+    if (!out.Open(path)){
+      return false;
+    }
+    out.Write(kTokenStreamMagic, sizeof(kTokenStreamMagic));
+    out << (char) kTokenStreamVersion << (char) (INT_CONST - YYerror);
+    Varint(source_size);
+    Varint(strlen(source_name));
+    out << source_name;
+    line = 1;
+    offset = 0;
+    local.clear();
+    defined = 0;
+    return true;
+  }
+
+  // text 指向 token 在源文件里的开头, 只有 INT_CONST 要用它区分写法
+  void Write(int token, const YYSTYPE &lval, const char *text, int token_line, uint32_t token_offset, size_t token_column) {
+    uint8_t kind = Token_Stream_Kind(token);
+    if (token == INT_CONST && text[0] == '0'){
+      kind = text[1] == 'x' || text[1] == 'X' ? kTokKindHex : kTokKindOctal;
+    }
+    out << (char) kind;
+    Varint(token_line - line);
+    Varint(token_offset - offset);
+    if (token_line != line){
+      Varint(token_column);
+    }
+    line = token_line;
+    offset = token_offset;
+    if (token == IDENT){
+      Symbol(lval.sym_val);
+    }else if (token == INT_CONST){
+      Varint((uint32_t) lval.int_val);
+    }
+  }
+
+  bool Close() {
+    out << (char) kTokKindEnd;
+    return out.Close();
+  }
+
+ private:
+  const StringInterner &interner;
+  OutputBuffer out;
+  int line = 1;
+  uint32_t offset = 0;
+  // Sym 到流内编号加 1, 0 表示还没写过
+  std::vector<uint32_t> local;
+  uint32_t defined = 0;
+
+  void Varint(uint64_t v) {
+    while (v >= 0x80){
+      out << (char) (v | 0x80);
+      v >>= 7;
+    }
+    out << (char) v;
+  }
+
+  void Symbol(Sym sym) {
+    if (sym >= local.size()){
+      local.resize(interner.Size());
+    }
+    if (local[sym]){
+      Varint(local[sym] - 1);
+      return;
+    }
+    local[sym] = ++defined;
+    Varint(defined - 1);
+    Varint(interner.Len(sym));
+    out.Write(interner.Str(sym), interner.Len(sym));
+  }
+};
+
+// ---------- 读 ----------
+
+// 代替扫描器给 parser 供 token, 和扫描器一样填 YYSTYPE, 维护行号和 token 文本, 并输出 -lex 结果
+// 原来的源文件由调用者按 Source_Name 和 Source_Size 登记进 SourceMap, 没有源文本, 行首随读随登记
+class TokenStreamReader {
+ public:
+  explicit TokenStreamReader(Compilation &c) : c(c) {}
+
+  void Reset(const char *data, size_t size) {
+    p = (const uint8_t *) data + sizeof(kTokenStreamMagic);
+    end = (const uint8_t *) data + size;
+    if (p[0] != kTokenStreamVersion || p[1] != INT_CONST - YYerror){
+      c.Diag() << "ERROR! Token stream was written by a different compiler version" << std::endl;
+      c.Fail(1);
+    }
+    p += 2;
+    uint64_t source_size = Varint();
+    uint64_t name_len = Varint();
+    if (source_size >= UINT32_MAX || name_len > (uint64_t) (end - p)){
+      Corrupt();
+    }
+    name.assign((const char *) p, name_len);
+    p += name_len;
+    size = source_size;
+    offset = 0;
+    line = 1;
+    column = 1;
+    symbols.clear();
+  }
+
+  const char *Source_Name() const {
+    return name.c_str();
+  }
+
+  size_t Source_Size() const {
+    return size;
+  }
+
+  int Next(YYSTYPE *lval) {
+    uint64_t kind = Varint();
+    if (kind == kTokKindEnd){
+      text.clear();
+      return 0;
+    }
+    if (kind >= kTokKindCount || !kNames[kind].token){
+      Corrupt();
+    }
+    const TokenStreamName &name = kNames[kind];
+    uint64_t line_delta = Varint();
+    uint64_t offset_delta = Varint();
+    if (offset_delta > UINT32_MAX - offset){
+      Corrupt();
+    }
+    offset += offset_delta;
+    if (line_delta){
+      line += line_delta;
+      column = Varint();
+      if (column == 0 || column > offset + 1){
+        Corrupt();
+      }
+      c.source_map.Add_Line(offset - column + 1, line);
+    }else {
+      column += offset_delta;
+    }
+
+    if (name.token == IDENT){
+      lval->sym_val = Symbol();
+      text = c.interner.Str(lval->sym_val);
+      c.Print_Token(name.name, text.c_str());
+    }else if (name.token == INT_CONST){
+      lval->int_val = (int) (uint32_t) Varint();
+      text = std::to_string(lval->int_val);
+      c.Print_Token(name.name, lval->int_val);
+    }else {
+      text = name.text;
+      c.Print_Token(name.name, name.text);
+    }
+    return name.token;
+  }
+
+  // 当前 token 的文本, yyerror 报错时要用
+  const char *Text() const {
+    return text.c_str();
+  }
+
+  int Line() const {
+    return line;
+  }
+
+  // 当前 token 在源文件里的偏移
+  uint32_t Offset() const {
+    return offset;
+  }
+
+  // 当前 token 的列, 从 1 开始
+  size_t Column() const {
+    return column;
+  }
+
+ private:
+  Compilation &c;
+  const uint8_t *p = NULL;
+  const uint8_t *end = NULL;
+  // 原来的源文件
+  std::string name;
+  size_t size = 0;
+  uint32_t offset = 0;
+  int line = 1;
+  size_t column = 1;
+  // 流内编号到 Sym
+  std::vector<Sym> symbols;
+  std::string text;
+
+  static constexpr std::array<TokenStreamName, kTokKindCount> kNames = Token_Stream_Make_Names();
+
+  uint64_t Varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7){
+      if (p >= end){
+        Corrupt();
+      }
+      uint8_t b = *p++;
+      v |= (uint64_t) (b & 0x7f) << shift;
+      if (!(b & 0x80)){
+        return v;
+      }
+    }
+    Corrupt();
+    return 0;
+  }
+
+  Sym Symbol() {
+    uint64_t id = Varint();
+    if (id < symbols.size()){
+      return symbols[id];
+    }
+    if (id > symbols.size()){
+      Corrupt();
+    }
+    uint64_t len = Varint();
+    if (len > (uint64_t) (end - p)){
+      Corrupt();
+    }
+    Sym sym = c.interner.Intern((const char *) p, len);
+    p += len;
+    symbols.push_back(sym);
+    return sym;
+  }
+
+  [[noreturn]] void Corrupt() {
+    c.Diag() << "ERROR! Corrupted token stream" << std::endl;
+    c.Fail(1);
+  }
+};
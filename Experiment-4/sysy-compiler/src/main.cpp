@@ -1,114 +1,492 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <memory>
 #include <cstring>
-#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 #include "assert.h"  
+#include "Arena.h"
 #include "AST.h"
+#include "ASTExport.h"
+#include "Compilation.h"
+#include "FlatAST.h"
+#include "Intern.h"
+#include "KoopaIR.h"
+#include "KoopaRaw.h"
+#include "Location.h"
+#include "RiscV.h"
+#include "Semantic.h"
+#include "SourceFile.h"
+#include "ThreadPool.h"
+#include "TokenSink.h"
 
 using namespace std;
+namespace fs = std::filesystem;
 
 // 声明 lexer 的输入, 以及 parser 函数
-// 为什么不引用 sysy.tab.hpp 呢? 因为首先里面没有 yyin 的定义
-// 其次, 因为这个文件不是我们自己写的, 而是被 Bison 生成出来的
+// 为什么不引用 sysy.tab.hpp 呢? 因为这个文件不是我们自己写的, 而是被 Bison 生成出来的
 // 你的代码编辑器/IDE 很可能找不到这个文件, 然后会给你报错 (虽然编译不会出错)
 // 看起来会很烦人, 于是干脆采用这种看起来 dirty 但实际很有效的手段
-extern FILE *yyin;
-extern int yyparse(unique_ptr<BaseAST> &ast);
-extern int PRINT_TOKEN;
-extern void print_token(const string& token, const string& name);
+extern void scan_source_file(Compilation &c);
+extern bool write_token_stream(Compilation &c, const char *path);
+extern int yyparse(Compilation &c, unique_ptr<BaseAST> &ast);
+extern int lex_token(Compilation &c);
 
-// Lex 词法分析输出导致代码非常 dirty，有时间再优化吧
 const char * mode;
 const char * input;
 const char * output;
 
-void print_token(const string& token, const string& name){
-  if (PRINT_TOKEN){
-    int old = dup(1);
-    freopen(output, "a", stdout);
-    // std::cout << token << ": " << name << endl;
-    std::cout << token << ": " << name << endl;
-    dup2(old, 1);
+static const char *kUsage = "Usage: ./compiler -koopa | -koopa-raw | -riscv | -lex | -lex-bin | -lex-bench | -ast | -ast-json | -ast-dot | -semantic input_file -o output_file [-scanner=flex | -scanner=hand]\n"
+                            "       ./compiler mode1 mode2 ... input_file -o output_file1 -o output_file2 ... [-scanner=flex | -scanner=hand]\n"
+                            "       ./compiler -batch -koopa | -koopa-raw | -riscv | -lex | -lex-bin | -ast | -ast-json | -ast-dot | -semantic input_dir | list_file -o output_dir [-scanner=flex | -scanner=hand] [-j=N]\n";
+
+// 当前线程正在编译的单元
+thread_local Compilation *ctx = NULL;
+
+// -lex-bench: 两个扫描器各自把输入完整扫描若干遍, 只数 token 不建 AST
+static void lex_bench(Compilation &c){
+  // 每个扫描器至少扫 32 MiB
+  size_t rounds = (32u << 20) / (c.source_file.Size() + 1) + 1;
+  FILE *out = fopen(output, "w");
+  if (!out){
+    printf("ERROR! Cannot open output file %s\n", output);
+    exit(1);
+  }
+  fprintf(out, "%-8s %10s %10s %10s %10s\n", "scanner", "tokens", "ms", "MB/s", "ns/token");
+  for (int hand = 0; hand < 2; hand++){
+    c.hand_scanner = hand;
+    size_t tokens = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++){
+      scan_source_file(c);
+      while (lex_token(c)){
+        tokens++;
+      }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    fprintf(out, "%-8s %10zu %10.1f %10.1f %10.2f\n", hand ? "hand" : "flex", tokens / rounds, ms,
+            c.source_file.Size() * rounds / 1048576.0 / (ms / 1000), ms * 1e6 / tokens);
   }
+  fclose(out);
 }
 
-int main(int argc, const char *argv[]) {
-  // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
-  // compiler 模式 输入文件 -o 输出文件
-  // compiler mode input_file -o output_file
+// 一次调用要产生的一种输出
+typedef struct{
+  const char *mode;
+  const char *path;
+} CompileOutput;
 
-  if (argc == 2 && strcmp(argv[1], "-help") == 0){
-    printf("Usage: ./compiler -koopa | -lex | -ast | -semantic input_file -o output_file\n");
-    exit(0);
+// 要求了 mode 这种输出时返回它的输出文件, 否则返回 NULL
+static const char *find_output(const vector<CompileOutput> &outputs, const char *mode){
+  for (const CompileOutput &o : outputs){
+    if (strcmp(o.mode, mode) == 0){
+      return o.path;
+    }
   }
-  else if (argc != 5){
-    printf("ERROR! Usage: ./compiler -koopa | -lex | -ast | -semantic input_file -o output_file\n");
-    exit(0);
+  return NULL;
+}
+
+// 关闭输出文件之后调用, ok 为 false 时输出不完整 (比如磁盘满了), 报错并放弃
+static void check_output(Compilation &c, bool ok, const char *path){
+  if (!ok){
+    c.Diag() << "ERROR! Cannot write output file " << path << endl;
+    c.Fail(1);
   }
+}
 
-  mode = argv[1];
-  input = argv[2];
-  output = argv[4];
+// 编译一个文件, 只扫描和解析一遍, 要求的每种输出都由这一棵 AST 得到
+// 出错都走 c.Fail: 单文件模式直接退出进程, -batch 模式抛出 CompileError 只放弃这一个文件
+static void compile(Compilation &c, const char *input, const vector<CompileOutput> &outputs){
+  // 映射输入文件, 并且指定 lexer 在解析的时候扫描这块内存
+  if (!c.source_file.Open(input)){
+    c.Diag() << "ERROR! Cannot open input file " << input << endl;
+    c.Fail(1);
+  }
+  scan_source_file(c);
 
-  // 非常 dirty
-  if (strcmp(mode, "-lex") == 0)
+  if (const char *output = find_output(outputs, "-lex-bin"))
   {
-    // 清空
-    int old = dup(1);
-    freopen(output, "w", stdout);
-    dup2(old, 1);
-    PRINT_TOKEN=1;
-
-    // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
-    yyin = fopen(input, "r");
-    assert(yyin);    
-    
-    // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-    // parse input file
-    unique_ptr<BaseAST> ast;
-    auto ret = yyparse(ast);
-    assert(!ret);
+    // 只扫描不解析, token 写成二进制流, 之后任何模式都可以直接拿它当输入
+    check_output(c, write_token_stream(c, output), output);
+    // 有词法错误时流里缺了出错的 token, 不留下一个之后能编译通过的 .tok
+    if (c.error_count){
+      error_code ec;
+      fs::remove(output, ec);
+      c.Fail(1);
+    }
+    return;
+  }
 
-  }else {
-    // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
-    yyin = fopen(input, "r");
-    assert(yyin);
-    
-    // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-    // parse input file
-    unique_ptr<BaseAST> ast;
-    auto ret = yyparse(ast);
-    assert(!ret);
-
-    int old = dup(1);
-
-    if (strcmp(mode, "-koopa") == 0)
-    {
-      // Dump Koopa IR
-      freopen(output, "w", stdout);
-      ast->Dump();
-      dup2(old, 1);
+  // -lex 的 token 在解析的同时输出
+  const char *lex_output = find_output(outputs, "-lex");
+  if (lex_output)
+  {
+    if (!c.token_sink.Open(lex_output)){
+      c.Diag() << "ERROR! Cannot open output file " << lex_output << endl;
+      c.Fail(1);
     }
-    else if (strcmp(mode, "-ast") == 0)
-    {
-      freopen(output, "w", stdout);
-      ast->Print_AST();
-      dup2(old, 1);
-    }  
-    else if (strcmp(mode, "-semantic") == 0)
+    c.print_token = true;
+  }
+
+  // 只生成 IR 时表达式建成折叠的 ExprAST, 结点少得多; 要输出 AST 时保留原来的逐层结构
+  c.collapse_exp = !find_output(outputs, "-ast") && !find_output(outputs, "-ast-json") && !find_output(outputs, "-ast-dot");
+
+  // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
+  // parse input file
+  unique_ptr<BaseAST> ast;
+  auto ret = yyparse(c, ast);
+  if (lex_output)
+  {
+    // 出错前已经识别出的 token 也要写出去
+    check_output(c, c.token_sink.Close(), lex_output);
+  }
+  // 词法和语法错误都已经在解析时报出来了
+  if (ret || c.error_count){
+    c.Fail(1);
+  }
+  // 结点内存归 arena 所有, 不用再逐个析构
+  BaseAST *root = ast.release();
+
+  if (const char *output = find_output(outputs, "-ast"))
+  {
+    // 先压成扁平数组, 再顺序扫描, 写进输出缓冲区
+    OutputBuffer out;
+    if (!out.Open(output)){
+      c.Diag() << "ERROR! Cannot open output file " << output << endl;
+      c.Fail(1);
+    }
+    FlatAST flat;
+    flat.Build(root);
+    flat.Print_AST(out);
+    check_output(c, out.Close(), output);
+  }
+
+  if (const char *output = find_output(outputs, "-ast-json"))
+  {
+    // 每行一个结点, 边遍历边写
+    OutputBuffer out;
+    if (!out.Open(output)){
+      c.Diag() << "ERROR! Cannot open output file " << output << endl;
+      c.Fail(1);
+    }
+    ASTJsonWriter writer(out);
+    Export_AST(root, writer);
+    check_output(c, out.Close(), output);
+  }
+
+  if (const char *output = find_output(outputs, "-ast-dot"))
+  {
+    OutputBuffer out;
+    if (!out.Open(output)){
+      c.Diag() << "ERROR! Cannot open output file " << output << endl;
+      c.Fail(1);
+    }
+    ASTDotWriter writer(out);
+    Export_AST(root, writer);
+    writer.Finish();
+    check_output(c, out.Close(), output);
+  }
+
+  const char *koopa_output = find_output(outputs, "-koopa");
+  const char *raw_output = find_output(outputs, "-koopa-raw");
+  const char *riscv_output = find_output(outputs, "-riscv");
+  // 语义检查只做一遍, 生成 IR 之前必须做
+  if (find_output(outputs, "-semantic") || koopa_output || raw_output || riscv_output)
+  {
+    Semantic_Analysis(root);
+  }
+
+  if (koopa_output)
+  {
+    // 把 Koopa IR 流式写进输出文件
+    if (!c.koopa.out.Open(koopa_output)){
+      c.Diag() << "ERROR! Cannot open output file " << koopa_output << endl;
+      c.Fail(1);
+    }
+    root->Dump();
+    check_output(c, c.koopa.out.Close(), koopa_output);
+  }
+
+  if (raw_output || riscv_output)
+  {
+    // 直接在内存里搭 raw program, 不经过文本; -koopa-raw 和 -riscv 共用这一份
+    if (koopa_output){
+      c.koopa.Reset();
+    }
+    KoopaRawBuilder builder;
+    c.koopa.raw = &builder;
+    root->Dump();
+    c.koopa.raw = NULL;
+    const koopa_raw_program_t &raw = builder.Finish();
+
+    if (raw_output)
     {
-      ast->Semantic_Analysis();
+      // 交给 libkoopa 检查并输出
+      koopa_program_t program;
+      if (koopa_generate_raw_to_koopa(&raw, &program) != KOOPA_EC_SUCCESS){
+        c.Diag() << "ERROR! Invalid Koopa IR" << endl;
+        c.Fail(1);
+      }
+      koopa_dump_to_file(program, raw_output);
+      koopa_delete_program(program);
     }
-    else
+    if (riscv_output)
     {
-      printf("ERROR! Usage: ./compiler -koopa | -lex | -ast | -semantic input_file -o output_file\n");
+      // 直接翻译成 RV32IM 汇编
+      RiscVGen riscv;
+      if (!riscv.out.Open(riscv_output)){
+        c.Diag() << "ERROR! Cannot open output file " << riscv_output << endl;
+        c.Fail(1);
+      }
+      riscv.Generate(raw);
+      check_output(c, riscv.out.Close(), riscv_output);
+    }
+  }
+}
+
+// -batch 的一个输入文件
+typedef struct{
+  string input;
+  string output;
+  uintmax_t size;
+  bool failed;
+  // 在输入里的次序, 报错按它输出
+  size_t order;
+  // 这个文件的报错, 全部编译完再输出
+  string diag;
+} BatchUnit;
+
+// -batch 各模式输出文件名的后缀, 和 test/ 下的期望输出同名; NULL 表示不支持
+static const char *batch_suffix(const char *mode){
+  if (strcmp(mode, "-lex") == 0) return "_lex.txt";
+  if (strcmp(mode, "-lex-bin") == 0) return ".tok";
+  if (strcmp(mode, "-ast") == 0) return "_ast.txt";
+  if (strcmp(mode, "-ast-json") == 0) return "_ast.json";
+  if (strcmp(mode, "-ast-dot") == 0) return "_ast.dot";
+  if (strcmp(mode, "-koopa") == 0 || strcmp(mode, "-koopa-raw") == 0) return "_koopa.txt";
+  if (strcmp(mode, "-riscv") == 0) return "_riscv.txt";
+  // 只报错, 不写输出文件
+  if (strcmp(mode, "-semantic") == 0) return "";
+  return NULL;
+}
+
+// 输入是目录时递归收集其中的 .c 文件, 输出保持相对目录结构;
+// 否则是文件列表, 每行一个路径 (空行和 # 开头的行跳过), 输出都直接放在输出目录下
+static bool collect_batch_units(const char *input, const fs::path &out_dir, const char *suffix, vector<BatchUnit> &units){
+  error_code ec;
+  if (fs::is_directory(input, ec)){
+    for (auto it = fs::recursive_directory_iterator(input, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)){
+      if (it->is_regular_file(ec) && it->path().extension() == ".c"){
+        fs::path rel = fs::relative(it->path(), input, ec).parent_path();
+        units.push_back({it->path().string(), (out_dir / rel / it->path().stem()).string() + suffix, 0, false, 0, ""});
+      }
+    }
+    if (ec){
+      printf("ERROR! Cannot read input directory %s\n", input);
+      return false;
+    }
+    // 目录遍历的次序由文件系统决定, 按路径排好, 每次运行的报错次序都一样
+    sort(units.begin(), units.end(), [](const BatchUnit &a, const BatchUnit &b) { return a.input < b.input; });
+  }else {
+    ifstream list(input);
+    if (!list){
+      printf("ERROR! Cannot open input file %s\n", input);
+      return false;
+    }
+    set<string> seen;
+    string line;
+    while (getline(list, line)){
+      while (!line.empty() && isspace((unsigned char) line.back())){
+        line.pop_back();
+      }
+      if (line.empty() || line[0] == '#'){
+        continue;
+      }
+      string out = (out_dir / fs::path(line).stem()).string() + suffix;
+      if (*suffix && !seen.insert(out).second){
+        printf("ERROR! %s and another input both write %s\n", line.c_str(), out.c_str());
+        return false;
+      }
+      units.push_back({line, out, 0, false, 0, ""});
+    }
+  }
+  for (BatchUnit &u : units){
+    u.order = &u - units.data();
+    u.size = fs::file_size(u.input, ec);
+    if (ec){
+      u.size = 0;
+    }
+    if (*suffix){
+      fs::create_directories(fs::path(u.output).parent_path(), ec);
+    }
+  }
+  return true;
+}
+
+// -batch: 一个进程编译一整批文件, 每个文件一个独立的 Compilation, 由 work-stealing 线程池分到所有核上
+// 某个文件出错只放弃它自己, 报错等整批编译完按输入的次序输出, 最后打印总吞吐量
+static int batch_main(int argc, const char *argv[]){
+  if (argc < 6 || strcmp(argv[4], "-o") != 0){
+    printf("ERROR! %s", kUsage);
+    return 0;
+  }
+  const char *mode = argv[2];
+  const char *suffix = batch_suffix(mode);
+  if (!suffix){
+    printf("ERROR! -batch does not support %s\n", mode);
+    return 1;
+  }
+  bool hand = false;
+  unsigned jobs = thread::hardware_concurrency();
+  for (int i = 6; i < argc; i++){
+    if (strcmp(argv[i], "-scanner=hand") == 0){
+      hand = true;
+    }else if (strncmp(argv[i], "-j=", 3) == 0 && atoi(argv[i] + 3) > 0){
+      jobs = atoi(argv[i] + 3);
+    }else if (strcmp(argv[i], "-scanner=flex") != 0){
+      printf("ERROR! Unknown option %s\n", argv[i]);
+      return 0;
+    }
+  }
+
+  fs::path out_dir = argv[5];
+  vector<BatchUnit> units;
+  if (!collect_batch_units(argv[3], out_dir, suffix, units)){
+    return 1;
+  }
+  // 大文件先开始, 免得最后剩一个大文件拖着所有线程
+  stable_sort(units.begin(), units.end(), [](const BatchUnit &a, const BatchUnit &b) { return a.size > b.size; });
+
+  WorkStealingPool pool(jobs);
+  auto start = chrono::steady_clock::now();
+  pool.Run(units.size(), [&](unsigned, uint32_t i){
+    BatchUnit &u = units[i];
+    Compilation c;
+    c.batch = true;
+    c.hand_scanner = hand;
+    ctx = &c;
+    try {
+      compile(c, u.input.c_str(), {{mode, u.output.c_str()}});
+    } catch (const CompileError &) {
+      u.failed = true;
+    }
+    ctx = NULL;
+    u.diag = c.diag.str();
+  });
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  // 线程完成的次序每次不同, 排回输入的次序再输出报错
+  sort(units.begin(), units.end(), [](const BatchUnit &a, const BatchUnit &b) { return a.order < b.order; });
+  for (const BatchUnit &u : units){
+    if (!u.diag.empty()){
+      cout << u.input << ":\n" << u.diag;
+    }
+  }
+  cout << flush;
+
+  size_t failed = 0;
+  uintmax_t bytes = 0;
+  for (const BatchUnit &u : units){
+    failed += u.failed;
+    bytes += u.size;
+  }
+  printf("%zu files, %zu failed, %.1f MB, %u threads, %.1f ms, %.1f files/s, %.1f MB/s\n",
+         units.size(), failed, bytes / 1048576.0, pool.Workers(), ms,
+         units.size() / (ms / 1000), bytes / 1048576.0 / (ms / 1000));
+  return failed ? 1 : 0;
+}
+
+// 单文件模式认识的输出模式
+static bool is_mode(const char *arg){
+  static const char *modes[] = {"-koopa", "-koopa-raw", "-riscv", "-lex", "-lex-bin", "-lex-bench", "-ast", "-ast-json", "-ast-dot", "-semantic"};
+  for (const char *m : modes){
+    if (strcmp(arg, m) == 0){
+      return true;
     }
-  } 
-  
+  }
+  return false;
+}
+
+int main(int argc, const char *argv[]) {
+  // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
+  // compiler 模式 输入文件 -o 输出文件
+  // compiler mode input_file -o output_file
+  // 也可以一次给出多个模式, 每个模式按顺序对应一个 -o, 输入只扫描和解析一遍:
+  // compiler -lex -ast -koopa input_file -o lex_file -o ast_file -o koopa_file
+
+  if (argc == 2 && strcmp(argv[1], "-help") == 0){
+    printf("%s", kUsage);
+    exit(0);
+  }
+  else if (argc >= 2 && strcmp(argv[1], "-batch") == 0){
+    return batch_main(argc, argv);
+  }
+
+  vector<CompileOutput> outputs;
+  int arg = 1;
+  while (arg < argc && is_mode(argv[arg])){
+    for (const CompileOutput &o : outputs){
+      if (strcmp(o.mode, argv[arg]) == 0){
+        printf("ERROR! Duplicate mode %s\n", argv[arg]);
+        exit(0);
+      }
+    }
+    outputs.push_back({argv[arg++], NULL});
+  }
+  if (outputs.empty() || arg + 2 * (int) outputs.size() >= argc || argc > arg + 2 * (int) outputs.size() + 2){
+    printf("ERROR! %s", kUsage);
+    exit(0);
+  }
+  input = argv[arg++];
+  for (CompileOutput &o : outputs){
+    if (strcmp(argv[arg], "-o") != 0){
+      printf("ERROR! %s", kUsage);
+      exit(0);
+    }
+    o.path = argv[arg + 1];
+    arg += 2;
+  }
+  mode = outputs[0].mode;
+  output = outputs[0].path;
+  // -lex-bin 和 -lex-bench 只扫描不解析, 不能和别的模式一起用
+  if (outputs.size() > 1 && (find_output(outputs, "-lex-bin") || find_output(outputs, "-lex-bench"))){
+    printf("ERROR! -lex-bin and -lex-bench cannot be combined with other modes\n");
+    exit(0);
+  }
 
+  // 这个进程只编译一个文件, 它的全部状态都在 c 里
+  // 报错时直接 exit, 静态对象照样析构, 出错前写出的 token / IR 也会刷进文件
+  static Compilation c;
+  ctx = &c;
 
+  // 最后可选的一个参数在启动时选择扫描器, 默认用 flex
+  if (arg < argc){
+    if (strcmp(argv[arg], "-scanner=hand") == 0){
+      c.hand_scanner = true;
+    }else if (strcmp(argv[arg], "-scanner=flex") != 0){
+      printf("ERROR! Unknown option %s\n", argv[arg]);
+      exit(0);
+    }
+  }
 
+  if (strcmp(mode, "-lex-bench") == 0)
+  {
+    if (!c.source_file.Open(input)){
+      printf("ERROR! Cannot open input file %s\n", input);
+      exit(1);
+    }
+    lex_bench(c);
+    return 0;
+  }
+
+  compile(c, input, outputs);
   return 0;
-}
\ No newline at end of file
+}
@@ -2,26 +2,104 @@
   #include <memory>
   #include <string>
   #include "AST.h"
+  #include "Intern.h"
+  #include "Location.h"
 }
 
+// 位置就是 Location.h 里的一个 32 位整数, lexer 把每个 token 开头的位置写进 *lloc
 %locations
+%define api.location.type {Loc}
+
+// 可重入的 parser: yylval / yylloc 都是 yyparse 的局部变量, 编译单元的状态由参数 c 传进来
+%define api.pure full
+%param { Compilation &c }
 
 %{
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 #include "AST.h"
 
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
+using namespace std;
 
+void print_error(const string& msg, const char* token, int line, size_t column);
 
-using namespace std;
+// 解析栈从默认的 200 层开始, 满了由 yyoverflow 加倍, 深层嵌套的输入只受 YYMAXDEPTH 限制
+// bison 在 C++ 下自带的扩容要求 YYLTYPE_IS_TRIVIAL, 而定义了它 bison 又会用 {1, 1, 1, 1} 初始化位置,
+// 整数的 Loc 编译不过, 所以自己扩容, 见下面 %code 里的 Grow_Parse_Stack
+#define YYMAXDEPTH 10000000
+#define yyoverflow(msg, ss, ss_bytes, vs, vs_bytes, ls, ls_bytes, depth) \
+    Grow_Parse_Stack(c, ast, &yylloc, msg, ss, ss_bytes, vs, vs_bytes, ls, ls_bytes, depth)
+
+// 产生式的位置取第一个符号的位置 (空产生式沿用前一个符号的)
+// 同时记进 c.ast_loc, 这条产生式的动作里新建的结点都带上这个位置
+#define YYLLOC_DEFAULT(Current, Rhs, N) do { \
+    (Current) = (N) ? YYRHSLOC(Rhs, 1) : YYRHSLOC(Rhs, 0); \
+    c.ast_loc = (Current); \
+} while (0)
+
+// c.collapse_exp 时表达式的产生式只建 ExprAST, 单孩子的产生式直接把孩子传上去
+static BaseAST *New_Expr(OpKind op, BaseAST *lhs, BaseAST *rhs){
+  auto ast = new ExprAST();
+  ast->op = op;
+  ast->lhs = unique_ptr<BaseAST>(lhs);
+  ast->rhs = unique_ptr<BaseAST>(rhs);
+  return ast;
+}
+
+// 十进制的 2147483648 只能直接跟在一元 '-' 后面
+// UnaryExp 归约进上一层时检查: loc 是这个 UnaryExp 的开头, negated 表示上一层是一元 '-'
+static void Check_Int_Min(Compilation &c, Loc loc, bool negated){
+  if (c.int_min_literal == kNoLoc || c.int_min_literal != loc){
+    return;
+  }
+  c.int_min_literal = kNoLoc;
+  if (!negated){
+    SourcePos pos = c.source_map.Decode(loc);
+    print_error("Integer literal out of range", "2147483648", pos.line, pos.column);
+  }
+}
 
 %}
 
+// 声明 lexer 函数和错误处理函数, 要用到上面生成的 YYSTYPE
+%code {
+int yylex(YYSTYPE *lval, Loc *lloc, Compilation &c);
+void yyerror(Loc *lloc, Compilation &c, std::unique_ptr<BaseAST> &ast, const char *s);
+
+// 把一个栈搬进 buf 里新分配的 depth 层, 旧的内存 (第一次是 yyparse 里的数组) 不再使用
+template <typename T>
+static void Grow_Stack(std::vector<char> &buf, T **stack, size_t used_bytes, size_t depth){
+  std::vector<char> grown(depth * sizeof(T));
+  memcpy(grown.data(), *stack, used_bytes);
+  buf.swap(grown);
+  *stack = (T *) buf.data();
+}
+
+// yyoverflow: 三个栈一起加倍, 放在 c.parse_stacks 里; 已经到 YYMAXDEPTH 时报错, depth 不变, bison 随即放弃
+template <typename S, typename V, typename L, typename N>
+static void Grow_Parse_Stack(Compilation &c, std::unique_ptr<BaseAST> &ast, Loc *lloc, const char *msg,
+                             S **ss, size_t ss_bytes, V **vs, size_t vs_bytes, L **ls, size_t ls_bytes, N *depth){
+  if (*depth >= YYMAXDEPTH){
+    yyerror(lloc, c, ast, msg);
+    return;
+  }
+  *depth = std::min<N>(*depth * 2, YYMAXDEPTH);
+  Grow_Stack(c.parse_stacks[0], ss, ss_bytes, *depth);
+  Grow_Stack(c.parse_stacks[1], vs, vs_bytes, *depth);
+  Grow_Stack(c.parse_stacks[2], ls, ls_bytes, *depth);
+}
+
+// 定义了 yyoverflow 之后, 生成的 yyparse 里 bison 自己扩容用的 yyexhaustedlab 标号用不到
+// 只在 yyparse 里关掉这个警告, 下面 %% 之后恢复
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-label"
+}
+
 // 定义 parser 函数和错误处理函数的附加参数
 // 我们需要返回一个字符串作为 AST, 所以我们把附加参数定义成字符串的智能指针
 // 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的字符串
@@ -32,15 +110,20 @@ using namespace std;
 // 之前我们在 lexer 中用到的 str_val 和 int_val 就是在这里被定义的
 // 至于为什么要用字符串指针而不直接用 string 或者 unique_ptr<string>?
 // 请自行 STFW 在 union 里写一个带析构函数的类会出现什么情况
+// 标识符在 lexer 里就驻留成编号, 之后只传这个编号
 %union {
   std::string *str_val;
+  Sym sym_val;
   int int_val;
+  OpKind op_val;
   BaseAST *ast_val;
+  ASTList *list_val;
 }
 
 // lexer 返回的所有 token 种类的声明
 // 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
-%token <str_val> IDENT INT RETURN CONST VOID 
+%token <sym_val> IDENT
+%token <str_val> INT RETURN CONST VOID 
 %token <str_val> LE GE EQ NE AND OR IF THEN 
 %token <str_val> ELSE WHILE CONTINUE BREAK
 %token <str_val> ADD SUB MUL DIV MOD ASSIGN SEMI COMMA LPAREN RPAREN LBRACE RBRACE LBRACKET RBRACKET
@@ -52,7 +135,11 @@ using namespace std;
 %type <ast_val> Number Exp PrimaryExp UnaryExp AddExp MulExp RelExp EqExp 
 %type <ast_val> LAndExp LOrExp Decl ConstDecl BType ConstDef ConstInitVal 
 %type <ast_val> LVal ConstExp VarDecl VarDecl_ VarDef InitVal Bracket Brace
-%type <str_val> UnaryOp
+%type <list_val> ConstDefs VarDefs
+%type <op_val> UnaryOp
+
+// 错误恢复时丢掉的列表; 结点都在 arena 里, 不用管
+%destructor { delete $$; } <list_val>
 
 %%
 
@@ -72,36 +159,46 @@ CompUnit
 CompUnits 
   : FuncDefOrVarDecl {
     auto ast = new CompUnitsAST();
-    ast->funcdef_or_vardecl = unique_ptr<BaseAST>($1);
+    ast->items.emplace_back($1);
     $$ = ast;
   }
   | ConstDecl {
     auto ast = new CompUnitsAST();
-    ast->const_decl = unique_ptr<BaseAST>($1);
+    ast->items.emplace_back($1);
     $$ = ast;
   }
   | CompUnits FuncDefOrVarDecl {
-    auto ast = new CompUnitsAST();
-    ast->comp_units = unique_ptr<BaseAST>($1);
-    ast->funcdef_or_vardecl = unique_ptr<BaseAST>($2);
-    $$ = ast;
+    ((CompUnitsAST *) $1)->items.emplace_back($2);
+    $$ = $1;
   }
   | CompUnits ConstDecl {
-    auto ast = new CompUnitsAST();
-    ast->comp_units = unique_ptr<BaseAST>($1);
-    ast->const_decl = unique_ptr<BaseAST>($2);
-    $$ = ast;
+    ((CompUnitsAST *) $1)->items.emplace_back($2);
+    $$ = $1;
   }
   | VOID FuncDef_ {
     auto ast = new CompUnitsAST();
-    ast->func_def = unique_ptr<BaseAST>($2);
+    ((FuncDefAST_ *) $2)->func_type = "void";
+    ast->items.emplace_back($2);
     $$ = ast;
   }  
   | CompUnits VOID FuncDef_ {
-    auto ast = new CompUnitsAST();
-    ast->comp_units = unique_ptr<BaseAST>($1);
-    ast->func_def = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    ((FuncDefAST_ *) $3)->func_type = "void";
+    ((CompUnitsAST *) $1)->items.emplace_back($3);
+    $$ = $1;
+  }
+  | error SEMI {
+    // 函数和声明里都没能同步上的错误丢到下一个 ';' 或 '}', 接着解析后面的定义
+    // 不调 yyerrok: 丢掉的多半是半个函数体, 紧跟着的几个 token 再报错也只是连锁的
+    $$ = new CompUnitsAST();
+  }
+  | error RBRACE {
+    $$ = new CompUnitsAST();
+  }
+  | CompUnits error SEMI {
+    $$ = $1;
+  }
+  | CompUnits error RBRACE {
+    $$ = $1;
   }
   ;
   ;
@@ -135,48 +232,51 @@ Decl
   ;
 
 ConstDecl
-  : CONST BType ConstDef SEMI{
+  : CONST BType ConstDefs SEMI{
     auto ast = new ConstDeclAST();
     ast->b_type = unique_ptr<BaseAST>($2);
-    ast->const_def = unique_ptr<BaseAST>($3);
+    ast->const_defs = std::move(*$3);
+    delete $3;
     $$ = ast;
   }
+  | CONST error SEMI {
+    // 出错的声明丢到下一个 ';', 留一个空的声明占位
+    yyerrok;
+    $$ = new ConstDeclAST();
+  }
 
 BType
   : INT {
     auto ast = new BTypeAST();
-    ast->type = *unique_ptr<string>(new string("int"));
+    ast->type = "int";
     $$ = ast;
   }
 
 ConstDef
   : IDENT ASSIGN ConstInitVal {
     auto ast = new ConstDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->const_init_val = unique_ptr<BaseAST>($3);
     $$ = ast;
   }
-  | IDENT ASSIGN ConstInitVal COMMA ConstDef {
+  | IDENT Bracket ASSIGN ConstInitVal {
     auto ast = new ConstDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->const_init_val = unique_ptr<BaseAST>($3);
-    ast->const_def = unique_ptr<BaseAST>($5);
-    $$ = ast;
-  }
-  | IDENT LBRACKET Bracket RBRACKET ASSIGN ConstInitVal {
-    auto ast = new ConstDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->bracket = unique_ptr<BaseAST>($3);
-    ast->const_init_val = unique_ptr<BaseAST>($6);
+    ast->ident = $1;
+    ast->bracket = unique_ptr<BaseAST>($2);
+    ast->const_init_val = unique_ptr<BaseAST>($4);
     $$ = ast;
   }  
-  | IDENT LBRACKET ConstExp RBRACKET ASSIGN ConstInitVal COMMA ConstDef {
-    auto ast = new ConstDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->bracket = unique_ptr<BaseAST>($3);
-    ast->const_init_val = unique_ptr<BaseAST>($6);
-    ast->const_def = unique_ptr<BaseAST>($8);
-    $$ = ast;
+  ;
+
+// 逗号分隔的多个定义, 左递归, 收集到一个数组里交给 ConstDecl
+ConstDefs
+  : ConstDef {
+    $$ = new ASTList();
+    $$->emplace_back($1);
+  }
+  | ConstDefs COMMA ConstDef {
+    $1->emplace_back($3);
+    $$ = $1;
   }
   ;
 
@@ -214,101 +314,94 @@ ConstInitVal
 Brace
   : ConstInitVal {
     auto ast = new BraceAST();
-    ast->const_init_val = unique_ptr<BaseAST>($1);
+    ast->items.emplace_back($1);
     $$ = ast;
   }
-  | ConstInitVal COMMA Brace {
-    auto ast = new BraceAST();
-    ast->const_init_val = unique_ptr<BaseAST>($1);
-    ast->brace = unique_ptr<BaseAST>($3);
-    $$ = ast;
+  | Brace COMMA ConstInitVal {
+    ((BraceAST *) $1)->items.emplace_back($3);
+    $$ = $1;
   }
   ;
 
 ConstExp
   : Exp {
-    auto ast = new ConstExpAST();
-    ast->exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
-  }
-  | Exp COMMA ConstExp {
-    auto ast = new ConstExpAST();
-    ast->exp = unique_ptr<BaseAST>($1);
-    ast->const_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new ConstExpAST();
+      ast->exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   ;
 
 VarDecl
-  : BType VarDef SEMI {
+  : BType VarDefs SEMI {
+    auto ast = new VarDeclAST();
+    ast->b_type = unique_ptr<BaseAST>($1);
+    ast->var_defs = std::move(*$2);
+    delete $2;
+    $$ = ast;
+  }
+  | BType error SEMI {
+    yyerrok;
     auto ast = new VarDeclAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->var_def = unique_ptr<BaseAST>($2);
     $$ = ast;
   }
   ;
   
 VarDecl_
-  : VarDef SEMI {
+  : VarDefs SEMI {
     auto ast = new VarDeclAST_();
-    ast->var_def = unique_ptr<BaseAST>($1);
+    ast->var_defs = std::move(*$1);
+    delete $1;
     $$ = ast;
   }
+  | error SEMI {
+    yyerrok;
+    $$ = new VarDeclAST_();
+  }
+  ;
+
+// 同 ConstDefs
+VarDefs
+  : VarDef {
+    $$ = new ASTList();
+    $$->emplace_back($1);
+  }
+  | VarDefs COMMA VarDef {
+    $1->emplace_back($3);
+    $$ = $1;
+  }
   ;
 
 VarDef 
   : IDENT {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     $$ = ast;
   }  
   | IDENT ASSIGN InitVal {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->init_val = unique_ptr<BaseAST>($3);
     $$ = ast;
   }
   | IDENT Bracket {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->bracket = unique_ptr<BaseAST>($2);
     $$ = ast;
   }  
   | IDENT Bracket ASSIGN InitVal {
     auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->bracket = unique_ptr<BaseAST>($2);
     ast->init_val = unique_ptr<BaseAST>($4);
     $$ = ast;
   }
-  | IDENT COMMA VarDef {
-    auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->var_def = unique_ptr<BaseAST>($3);
-    $$ = ast;
-  }
-  | IDENT ASSIGN InitVal COMMA VarDef { 
-    auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->init_val = unique_ptr<BaseAST>($3);
-    ast->var_def = unique_ptr<BaseAST>($5);
-    $$ = ast;
-  }
-  | IDENT Bracket COMMA VarDef {
-    auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->bracket = unique_ptr<BaseAST>($2);
-    ast->var_def = unique_ptr<BaseAST>($4);
-    $$ = ast;
-  }  
-  | IDENT Bracket ASSIGN InitVal COMMA VarDef {
-    auto ast = new VarDefAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->bracket = unique_ptr<BaseAST>($2);
-    ast->init_val = unique_ptr<BaseAST>($4);
-    ast->var_def = unique_ptr<BaseAST>($6);
-    $$ = ast;
-  }
+  ;
 
 InitVal
   : Exp {
@@ -331,14 +424,14 @@ FuncDef
   : FuncType IDENT LPAREN RPAREN Block {
     auto ast = new FuncDefAST();
     ast->func_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
     ast->block = unique_ptr<BaseAST>($5);
     $$ = ast;
   }
   | FuncType IDENT LPAREN FuncFParams RPAREN Block {
     auto ast = new FuncDefAST();
     ast->func_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
     ast->func_f_params = unique_ptr<BaseAST>($4);
     ast->block = unique_ptr<BaseAST>($6);
     $$ = ast;
@@ -348,13 +441,13 @@ FuncDef
 FuncDef_
   : IDENT LPAREN RPAREN Block {
     auto ast = new FuncDefAST_();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->block = unique_ptr<BaseAST>($4);
     $$ = ast;
   }
   | IDENT LPAREN FuncFParams RPAREN Block {
     auto ast = new FuncDefAST_();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->func_f_params = unique_ptr<BaseAST>($3);
     ast->block = unique_ptr<BaseAST>($5);
     $$ = ast;
@@ -364,12 +457,12 @@ FuncDef_
 FuncType
   : INT {
     auto ast = new FuncTypeAST();
-    ast->type = *new string("int");
+    ast->type = "int";
     $$ = ast;
   } 
   | VOID {
     auto ast = new FuncTypeAST();
-    ast->type = *new string("void");
+    ast->type = "void";
     $$ = ast;
   }
   ;
@@ -386,40 +479,50 @@ FuncFParam
   : BType IDENT {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
     $$ = ast;
   }
   | BType IDENT LBRACKET RBRACKET {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
+    ast->is_array = true;
     $$ = ast;
   }
   | BType IDENT LBRACKET RBRACKET Bracket {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
+    ast->is_array = true;
     ast->bracket = unique_ptr<BaseAST>($5);
     $$ = ast;
   }
   | BType IDENT COMMA FuncFParam {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
     ast->func_f_param = unique_ptr<BaseAST>($4);
     $$ = ast;
   }  
   | BType IDENT LBRACKET RBRACKET COMMA FuncFParam {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
+    ast->is_array = true;
     ast->func_f_param = unique_ptr<BaseAST>($6);
     $$ = ast;
   }
   | BType IDENT LBRACKET RBRACKET Bracket COMMA FuncFParam {
     auto ast = new FuncFParamAST();
     ast->b_type = unique_ptr<BaseAST>($1);
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
+    ast->loc = @2;
+    ast->is_array = true;
     ast->bracket = unique_ptr<BaseAST>($5);
     ast->func_f_param = unique_ptr<BaseAST>($7);
     $$ = ast;
@@ -432,70 +535,77 @@ Block
     ast->blockitem = unique_ptr<BaseAST>($2);
     $$ = ast;
   }
+  | LBRACE error RBRACE {
+    // 语句里没能同步上的错误丢到块结尾的 '}'
+    yyerrok;
+    auto ast = new BlockAST();
+    ast->blockitem = unique_ptr<BaseAST>(new BlockItemAST());
+    $$ = ast;
+  }
   ;
 
 BlockItem
   : Decl {
     auto ast = new BlockItemAST();
-    ast->decl = unique_ptr<BaseAST>($1);
+    ast->items.emplace_back($1);
     $$ = ast;
   }
   | Stmt {
     auto ast = new BlockItemAST();
-    ast->stmt = unique_ptr<BaseAST>($1);
+    ast->items.emplace_back($1);
     $$ = ast;
   }
-  | Decl BlockItem{
-    auto ast = new BlockItemAST();
-    ast->decl = unique_ptr<BaseAST>($1);
-    ast->block_item = unique_ptr<BaseAST>($2);
-    $$ = ast;
+  | BlockItem Decl {
+    ((BlockItemAST *) $1)->items.emplace_back($2);
+    $$ = $1;
   }
-  | Stmt BlockItem{
-    auto ast = new BlockItemAST();
-    ast->stmt = unique_ptr<BaseAST>($1);
-    ast->block_item = unique_ptr<BaseAST>($2);
-    $$ = ast;
+  | BlockItem Stmt {
+    ((BlockItemAST *) $1)->items.emplace_back($2);
+    $$ = $1;
   }
   ;
 
 Stmt
   : LVal ASSIGN Exp SEMI {
     auto ast = new StmtAST();
+    ast->stmt_kind = StmtKind::Assign;
     ast->l_val = unique_ptr<BaseAST>($1);
     ast->exp = unique_ptr<BaseAST>($3);
     $$ = ast;
   }
   | SEMI {
     auto ast = new StmtAST();
+    ast->stmt_kind = StmtKind::Empty;
     $$ = ast;
   }
   | Exp SEMI{
     auto ast = new StmtAST();
+    ast->stmt_kind = StmtKind::Exp;
     ast->exp = unique_ptr<BaseAST>($1);
     $$ = ast;
   }
   | Block {
     auto ast = new StmtAST();
+    ast->stmt_kind = StmtKind::Block;
     ast->block = unique_ptr<BaseAST>($1);
     $$ = ast;
   }
   | RETURN SEMI {
     auto ast = new StmtAST();
-    ast->symbol = *new string("return");
+    ast->stmt_kind = StmtKind::Return;
     $$ = ast;
   }
   | RETURN Exp SEMI {
     auto ast = new StmtAST();
     ast->exp = unique_ptr<BaseAST>($2);
-    ast->symbol = *new string("return");
+    ast->stmt_kind = StmtKind::Return;
     $$ = ast;
   }
   | IF LPAREN Exp RPAREN Stmt {
     auto ast = new StmtAST();
     ast->exp = unique_ptr<BaseAST>($3);
     ast->stmt_1 = unique_ptr<BaseAST>($5);
-    ast->symbol = *new string("if");
+    ast->stmt_kind = StmtKind::If;
     $$ = ast;
   }
   | IF LPAREN Exp RPAREN Stmt ELSE Stmt {
@@ -503,102 +613,142 @@ Stmt
     ast->exp = unique_ptr<BaseAST>($3);
     ast->stmt_1 = unique_ptr<BaseAST>($5);
     ast->stmt_2 = unique_ptr<BaseAST>($7);
-    ast->symbol = *new string("if");
+    ast->stmt_kind = StmtKind::If;
     $$ = ast;
   }
   | WHILE LPAREN Exp RPAREN Stmt {
     auto ast = new StmtAST();
     ast->exp = unique_ptr<BaseAST>($3);
     ast->stmt_1 = unique_ptr<BaseAST>($5);
-    ast->symbol = *new string("while");
+    ast->stmt_kind = StmtKind::While;
     $$ = ast;
   }
   | BREAK SEMI {
     auto ast = new StmtAST();
-    ast->symbol = *new string("break");
+    ast->stmt_kind = StmtKind::Break;
     $$ = ast;
   }
   | CONTINUE SEMI {
     auto ast = new StmtAST();
-    ast->symbol = *new string("continue");
+    ast->stmt_kind = StmtKind::Continue;
+    $$ = ast;
+  }
+  | error SEMI {
+    // 出错的语句丢到下一个 ';', 当成空语句继续解析
+    yyerrok;
+    auto ast = new StmtAST();
+    ast->stmt_kind = StmtKind::Empty;
     $$ = ast;
   }
   ;
 
 Exp 
   : LOrExp {
-    auto ast = new ExpAST();
-    ast->l_or_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new ExpAST();
+      ast->l_or_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   } 
-  | LOrExp COMMA Exp {
-    auto ast = new ExpAST();
-    ast->l_or_exp = unique_ptr<BaseAST>($1);
-    ast->exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
-  }
   ;
 
 LVal
   : IDENT {
     auto ast = new LValAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     $$ = ast;
   }
   | IDENT LBRACKET Exp RBRACKET {
     auto ast = new LValAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
+    ast->exp = unique_ptr<BaseAST>($3);
+    $$ = ast;
+  }
+  | IDENT LBRACKET Exp RBRACKET Bracket {
+    auto ast = new LValAST();
+    ast->ident = $1;
     ast->exp = unique_ptr<BaseAST>($3);
+    ast->bracket = unique_ptr<BaseAST>($5);
     $$ = ast;
   }
   ;
 
 PrimaryExp
   : LPAREN Exp RPAREN {
-    auto ast = new PrimaryExpAST();
-    ast->exp = unique_ptr<BaseAST>($2);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $2;
+    }else {
+      auto ast = new PrimaryExpAST();
+      ast->exp = unique_ptr<BaseAST>($2);
+      $$ = ast;
+    }
   }
   | Number {
-    auto ast = new PrimaryExpAST();
-    ast->number = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new PrimaryExpAST();
+      ast->number = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | LVal {
-    auto ast = new PrimaryExpAST();
-    ast->l_val = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new PrimaryExpAST();
+      ast->l_val = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   ;
 
 Number
   : INT_CONST {
-    auto ast = new NumberAST();
-    ast->number = *new string(to_string($1));
-    $$ = ast;
+    if (c.collapse_exp){
+      auto ast = new ExprAST();
+      ast->number = $1;
+      $$ = ast;
+    }else {
+      auto ast = new NumberAST();
+      ast->number = $1;
+      $$ = ast;
+    }
   }
   ;
 
 UnaryExp
   : PrimaryExp {
-    auto ast = new UnaryExpAST();
-    ast->primary_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new UnaryExpAST();
+      ast->primary_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | UnaryOp UnaryExp{
-    auto ast = new UnaryExpAST();
-    ast->unary_op = *unique_ptr<string>($1);
-    ast->unary_exp = unique_ptr<BaseAST>($2);
-    $$ = ast;
+    Check_Int_Min(c, @2, $1 == OpKind::Sub);
+    if (c.collapse_exp){
+      // 一元 '+' 不建结点
+      $$ = $1 == OpKind::Add ? $2 : New_Expr($1, $2, NULL);
+    }else {
+      auto ast = new UnaryExpAST();
+      ast->unary_op = $1;
+      ast->unary_exp = unique_ptr<BaseAST>($2);
+      $$ = ast;
+    }
   }
   | IDENT LPAREN RPAREN{
     auto ast = new UnaryExpAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     $$ = ast;
   }
   | IDENT LPAREN FuncRParams RPAREN{
     auto ast = new UnaryExpAST();
-    ast->ident = *unique_ptr<string>($1);
+    ast->ident = $1;
     ast->func_r_params = unique_ptr<BaseAST>($3);
     $$ = ast;
   }
@@ -606,13 +756,13 @@ UnaryExp
 
 UnaryOp 
   : ADD{
-    $$ = new string("+");
+    $$ = OpKind::Add;
   }
   | SUB{
-    $$ = new string("-");
+    $$ = OpKind::Sub;
   }
   | '!'{
-    $$ = new string("!");
+    $$ = OpKind::Not;
   }
   ;
 
@@ -622,145 +772,231 @@ FuncRParams
     ast->exp = unique_ptr<BaseAST>($1);
     $$ = ast;
   }
+  | Exp COMMA FuncRParams {
+    auto ast = new FuncRParamsAST();
+    ast->exp = unique_ptr<BaseAST>($1);
+    ast->func_r_params = unique_ptr<BaseAST>($3);
+    $$ = ast;
+  }
   ;
 
 MulExp
   : UnaryExp {
-    auto ast = new MulExpAST();
-    ast->unary_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    Check_Int_Min(c, @1, false);
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new MulExpAST();
+      ast->unary_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | MulExp MUL UnaryExp {
-    auto ast = new MulExpAST();
-    ast->mul_exp = unique_ptr<BaseAST>($1);
-    ast->mul_op = *unique_ptr<string>(new string("*"));
-    ast->unary_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    Check_Int_Min(c, @3, false);
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Mul, $1, $3);
+    }else {
+      auto ast = new MulExpAST();
+      ast->mul_exp = unique_ptr<BaseAST>($1);
+      ast->mul_op = OpKind::Mul;
+      ast->unary_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | MulExp DIV UnaryExp {
-    auto ast = new MulExpAST();
-    ast->mul_exp = unique_ptr<BaseAST>($1);
-    ast->mul_op = *unique_ptr<string>(new string("/"));
-    ast->unary_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    Check_Int_Min(c, @3, false);
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Div, $1, $3);
+    }else {
+      auto ast = new MulExpAST();
+      ast->mul_exp = unique_ptr<BaseAST>($1);
+      ast->mul_op = OpKind::Div;
+      ast->unary_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | MulExp MOD UnaryExp {
-    auto ast = new MulExpAST();
-    ast->mul_exp = unique_ptr<BaseAST>($1);
-    ast->mul_op = *unique_ptr<string>(new string("%"));
-    ast->unary_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    Check_Int_Min(c, @3, false);
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Mod, $1, $3);
+    }else {
+      auto ast = new MulExpAST();
+      ast->mul_exp = unique_ptr<BaseAST>($1);
+      ast->mul_op = OpKind::Mod;
+      ast->unary_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
 AddExp
   : MulExp {
-    auto ast = new AddExpAST();
-    ast->mul_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new AddExpAST();
+      ast->mul_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | AddExp ADD MulExp {
-    auto ast = new AddExpAST();
-    ast->add_exp = unique_ptr<BaseAST>($1);
-    ast->add_op = *unique_ptr<string>(new string("+"));
-    ast->mul_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Add, $1, $3);
+    }else {
+      auto ast = new AddExpAST();
+      ast->add_exp = unique_ptr<BaseAST>($1);
+      ast->add_op = OpKind::Add;
+      ast->mul_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | AddExp SUB MulExp {
-    auto ast = new AddExpAST();
-    ast->add_exp = unique_ptr<BaseAST>($1);
-    ast->add_op = *unique_ptr<string>(new string("-"));
-    ast->mul_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Sub, $1, $3);
+    }else {
+      auto ast = new AddExpAST();
+      ast->add_exp = unique_ptr<BaseAST>($1);
+      ast->add_op = OpKind::Sub;
+      ast->mul_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
 
 RelExp
   : AddExp {
-    auto ast = new RelExpAST();
-    ast->add_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new RelExpAST();
+      ast->add_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | RelExp '<' AddExp {
-    auto ast = new RelExpAST();
-    ast->rel_exp = unique_ptr<BaseAST>($1);
-    ast->rel_op = *unique_ptr<string>(new string("<"));
-    ast->add_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Lt, $1, $3);
+    }else {
+      auto ast = new RelExpAST();
+      ast->rel_exp = unique_ptr<BaseAST>($1);
+      ast->rel_op = OpKind::Lt;
+      ast->add_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | RelExp '>' AddExp {
-    auto ast = new RelExpAST();
-    ast->rel_exp = unique_ptr<BaseAST>($1);
-    ast->rel_op = *unique_ptr<string>(new string(">"));
-    ast->add_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Gt, $1, $3);
+    }else {
+      auto ast = new RelExpAST();
+      ast->rel_exp = unique_ptr<BaseAST>($1);
+      ast->rel_op = OpKind::Gt;
+      ast->add_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | RelExp LE AddExp {
-    auto ast = new RelExpAST();
-    ast->rel_exp = unique_ptr<BaseAST>($1);
-    ast->rel_op = *unique_ptr<string>(new string("<="));
-    ast->add_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Le, $1, $3);
+    }else {
+      auto ast = new RelExpAST();
+      ast->rel_exp = unique_ptr<BaseAST>($1);
+      ast->rel_op = OpKind::Le;
+      ast->add_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | RelExp GE AddExp {
-    auto ast = new RelExpAST();
-    ast->rel_exp = unique_ptr<BaseAST>($1);
-    ast->rel_op = *unique_ptr<string>(new string(">="));
-    ast->add_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Ge, $1, $3);
+    }else {
+      auto ast = new RelExpAST();
+      ast->rel_exp = unique_ptr<BaseAST>($1);
+      ast->rel_op = OpKind::Ge;
+      ast->add_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
 EqExp
   : RelExp {
-    auto ast = new EqExpAST();
-    ast->rel_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new EqExpAST();
+      ast->rel_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | EqExp EQ RelExp {
-    auto ast = new EqExpAST();
-    ast->eq_exp = unique_ptr<BaseAST>($1);
-    ast->eq_op = *unique_ptr<string>($2);
-    ast->rel_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Eq, $1, $3);
+    }else {
+      auto ast = new EqExpAST();
+      ast->eq_exp = unique_ptr<BaseAST>($1);
+      ast->eq_op = OpKind::Eq;
+      ast->rel_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   | EqExp NE RelExp {
-    auto ast = new EqExpAST();
-    ast->eq_exp = unique_ptr<BaseAST>($1);
-    ast->eq_op = *unique_ptr<string>($2);
-    ast->rel_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Ne, $1, $3);
+    }else {
+      auto ast = new EqExpAST();
+      ast->eq_exp = unique_ptr<BaseAST>($1);
+      ast->eq_op = OpKind::Ne;
+      ast->rel_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
 LAndExp
   : EqExp {
-    auto ast = new LAndExpAST();
-    ast->eq_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new LAndExpAST();
+      ast->eq_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | LAndExp AND EqExp {
-    auto ast = new LAndExpAST();
-    ast->l_and_exp = unique_ptr<BaseAST>($1);
-    ast->l_and_op = *unique_ptr<string>($2);
-    ast->eq_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::And, $1, $3);
+    }else {
+      auto ast = new LAndExpAST();
+      ast->l_and_exp = unique_ptr<BaseAST>($1);
+      ast->l_and_op = OpKind::And;
+      ast->eq_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
 LOrExp
   : LAndExp {
-    auto ast = new LOrExpAST();
-    ast->l_and_exp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = $1;
+    }else {
+      auto ast = new LOrExpAST();
+      ast->l_and_exp = unique_ptr<BaseAST>($1);
+      $$ = ast;
+    }
   }
   | LOrExp OR LAndExp {
-    auto ast = new LOrExpAST();
-    ast->l_or_exp = unique_ptr<BaseAST>($1);
-    ast->l_or_op = *unique_ptr<string>($2);
-    ast->l_and_exp = unique_ptr<BaseAST>($3);
-    $$ = ast;
+    if (c.collapse_exp){
+      $$ = New_Expr(OpKind::Or, $1, $3);
+    }else {
+      auto ast = new LOrExpAST();
+      ast->l_or_exp = unique_ptr<BaseAST>($1);
+      ast->l_or_op = OpKind::Or;
+      ast->l_and_exp = unique_ptr<BaseAST>($3);
+      $$ = ast;
+    }
   }
   ;
 
@@ -774,13 +1010,21 @@ LOrExp
 
 %%
 
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s) {
-  extern int yylineno;
-  extern char *yytext;
-  int len = strlen(yytext);
-  int i;
-  char buf[512] = {0};
-  for (i=0; i<len; ++i)
-    sprintf(buf, "%s%c", buf, yytext[i]);
-  fprintf(stderr, "ERROR: %s at symbol '%s' on line %d\n", s, buf, yylineno);
-}
\ No newline at end of file
+#pragma GCC diagnostic pop
+
+// 报错之后由上面的 error 产生式恢复, 接着解析, 解析完再由 main Fail
+void yyerror(Loc *lloc, Compilation &c, std::unique_ptr<BaseAST> &ast, const char *s) {
+  if (!c.Count_Error()){
+    return;
+  }
+  extern const char *lex_text(Compilation &c);
+  const char *text = lex_text(c);
+  // *lloc 是出错的 token (向前看符号) 的位置
+  SourcePos pos = c.source_map.Decode(*lloc);
+  // -batch 时和其他报错一起记进 c.diag, 整批编译完再输出
+  if (c.batch){
+    c.Diag() << "ERROR: " << s << " at symbol '" << text << "' at " << pos << std::endl;
+    return;
+  }
+  fprintf(stderr, "ERROR: %s at symbol '%s' at line: %u, column: %u\n", s, text, pos.line, pos.column);
+}
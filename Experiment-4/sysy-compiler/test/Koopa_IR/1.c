@@ -0,0 +1,43 @@
+const int N = 4, M = N * 2;
+int g;
+int arr[2][3] = {{1, 2}, {4}};
+int z[5];
+
+int sum(int a[], int n) {
+  int i = 0, s = 0;
+  while (i < n) {
+    if (a[i] < 0) {
+      i = i + 1;
+      continue;
+    }
+    s = s + a[i];
+    if (s > 100) break;
+    i = i + 1;
+  }
+  return s;
+}
+
+int row(int b[][3], int k) {
+  return b[k][1] + sum(b[k], 3);
+}
+
+void hello() {
+  putint(g);
+  return;
+}
+
+int main() {
+  int x[N][2] = {1, 2, {3}, 4};
+  int y = getint();
+  g = y;
+  if (y > 0 && !(y == 3) || y < -5) {
+    y = y * 2;
+  } else {
+    y = -y;
+  }
+  hello();
+  putint(sum(x[1], 2));
+  putint(row(arr, 0));
+  putarray(5, z);
+  return y % M;
+}
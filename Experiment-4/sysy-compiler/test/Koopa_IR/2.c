@@ -0,0 +1,2 @@
+int x_1 = 5;
+int main(){ int x = 1; { int x = 2; x_1 = x; } return x_1 + x; }
@@ -0,0 +1,6 @@
+# build/compiler -koopa test/hello.c -o test/hello.koopa
+
+for file in *.c; do
+    echo "Processing $file"
+    ../../build/compiler -koopa $file -o $(basename $file .c)_koopa.txt
+done
\ No newline at end of file
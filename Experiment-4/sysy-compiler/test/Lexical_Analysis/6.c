@@ -0,0 +1,13 @@
+int main() {
+    int a = 1;
+    int min = -2147483648;
+    int hex = 0x80000000;
+    int big = 2147483648;
+    int sub = a-2147483648;
+    int paren = -(2147483648);
+    int over = 4294967296;
+    int empty = 0x;
+    int octal = 0128;
+    int digit = 0x1G;
+    return 0;
+}
@@ -0,0 +1,10 @@
+# 用 Lexical_Analysis 和 Syntax_Analysis 下能正常扫描的测试文件拼一个大语料, 比较 flex 和手写扫描器
+# 结果写进 bench.txt
+
+corpus=/tmp/sysy_lex_corpus.c
+: > $corpus
+for i in $(seq 200); do
+    cat 1.c ../Syntax_Analysis/1.c ../Syntax_Analysis/3.c ../Syntax_Analysis/5.c ../hello.c >> $corpus
+done
+../../build/compiler -lex-bench $corpus -o bench.txt
+cat bench.txt
@@ -2,5 +2,7 @@
 
 for file in *.c; do
     echo "Processing $file"
-    ../../build/compiler -lex $file -o $(basename $file .c)_lex.txt
-done
\ No newline at end of file
+    ../../build/compiler -lex $file -o $(basename $file .c)_lex.txt > $(basename $file .c)_err.txt 2>&1
+    # 只有出错的文件留下 _err.txt, 里面是期望的报错
+    [ -s $(basename $file .c)_err.txt ] || rm $(basename $file .c)_err.txt
+done
@@ -0,0 +1,52 @@
+int buf[3000];
+int many(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j) {
+  return a - b + c * d - e + f * g - h + i * 100 + j;
+}
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+int sumarr(int a[], int n) {
+  int s = 0, i = 0;
+  while (i < n) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+int mix(int x, int y) {
+  int t = x * 3 + y;
+  int u = fib(x) + t * getint();
+  int w = t - u + fib(y);
+  return w + many(t, u, w, x, y, 1, 2, 3, 4, 5) + x;
+}
+int main() {
+  int big[1000];
+  int i = 0;
+  while (i < 1000) { big[i] = i * 7 - 300; buf[i * 3] = i; i = i + 1; }
+  putint(sumarr(big, 1000)); putch(10);
+  putint(sumarr(buf, 3000)); putch(10);
+  putint(many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10)); putch(10);
+  putint(fib(15)); putch(10);
+  putint(mix(5, 6)); putch(10);
+  int a = -17, b = 5;
+  putint(a / b); putch(32); putint(a % b); putch(32); putint(a / -4); putch(32); putint(a % 4); putch(10);
+  if (a < b && b != 0 || a / 0 > 1) putint(1); else putint(0);
+  if (!(a >= b) && (b <= 5) && (a == -17)) putint(2);
+  if (a > b || b == 6) putint(3);
+  putch(10);
+  int m[4][5][6];
+  i = 0;
+  while (i < 4) {
+    int j = 0;
+    while (j < 5) {
+      int k = 0;
+      while (k < 6) {
+        m[i][j][k] = i * 100 + j * 10 + k;
+        if (k == 3) { k = k + 1; continue; }
+        k = k + 1;
+      }
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  putint(m[3][4][5] + m[1][2][3] + sumarr(m[2][1], 6)); putch(10);
+  return m[2][3][4] % 256;
+}
@@ -0,0 +1,14 @@
+# build/compiler -riscv test/hello.c -o test/hello.S
+
+for file in *.c; do
+    echo "Processing $file"
+    name=$(basename $file .c)
+    ../../build/compiler -riscv $file -o ${name}_riscv.txt
+    # 有 RISC-V 工具链和 qemu 时, 链接 libsysy 之后直接跑一遍
+    if command -v qemu-riscv32-static > /dev/null; then
+        clang -x assembler ${name}_riscv.txt -c -o /tmp/${name}.o -target riscv32-unknown-linux-elf -march=rv32im -mabi=ilp32
+        ld.lld /tmp/${name}.o -L$CDE_LIBRARY_PATH/riscv32 -lsysy -o /tmp/${name}
+        qemu-riscv32-static /tmp/${name}
+        echo "exit $?"
+    fi
+done
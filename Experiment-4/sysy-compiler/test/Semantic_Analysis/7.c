@@ -0,0 +1,9 @@
+int main(){
+    int i = 0;
+    while (i < 10) {
+        i = i + 1;
+        if (i == 5) break;
+    }
+    continue;
+    return i;
+}
@@ -0,0 +1,8 @@
+void log(int x){
+    putint(x);
+}
+int main(){
+    log(1);
+    int a = log(2);
+    return a;
+}
@@ -0,0 +1,11 @@
+int main(){
+    if (a {
+        return 1;
+    }
+    return 0;
+}
+const int b 3;
+int c = ;
+int g(){
+    return 0x1G;
+}
@@ -0,0 +1,21 @@
+// 十六进制和八进制的字面量, 注释和空行都要在 token 流里还原出同样的行号和列号
+const int MASK = 0xFF;
+const int PERM = 0755;
+
+/* 多行注释
+   之后的 token 换了行 */
+int count(int n) {
+    int c = 0;
+    while (n > 0) {
+        if (n % 2 == 1) {
+            c = c + 1;
+        }
+        n = n / 2;
+    }
+    return c;
+}
+
+int main() {
+    int x = MASK - PERM + 0X1a + 017;
+    return count(x) + 2147483647 - 2147483647;
+}
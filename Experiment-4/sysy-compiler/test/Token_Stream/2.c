@@ -0,0 +1,8 @@
+int g = 0x10;
+
+int main() {
+    int a = 010;
+        int b = a + 
+            undefined_var;
+    return b;
+}
@@ -0,0 +1,7 @@
+int main() {
+    int a = 0x1f;
+
+    a = a +
+        ;
+    return a;
+}
@@ -0,0 +1,21 @@
+# token 流的往返测试: 每个 .c 先用 -lex-bin 写成 .tok, 再从 .tok 输出 -lex 和 -koopa,
+# 和直接编译 .c 得到的期望输出 (n_lex.txt, n_koopa.txt, 出错时的报错 n_err.txt) 逐字节比较
+# 报错里的行号和列号都是从 token 流里还原出来的
+
+tmp=$(mktemp -d)
+fail=0
+for file in *.c; do
+    name=$(basename $file .c)
+    ../../build/compiler -lex-bin $file -o $tmp/$name.tok
+    ../../build/compiler -lex $tmp/$name.tok -o $tmp/${name}_lex.txt > /dev/null 2>&1
+    ../../build/compiler -koopa $tmp/$name.tok -o $tmp/${name}_koopa.txt > $tmp/${name}_err.txt 2>&1
+    for out in ${name}_lex.txt ${name}_koopa.txt ${name}_err.txt; do
+        if [ -f $out ] && ! cmp -s $out $tmp/$out; then
+            echo "FAIL $out"
+            fail=1
+        fi
+    done
+done
+rm -rf $tmp
+[ $fail = 0 ] && echo "PASS"
+exit $fail
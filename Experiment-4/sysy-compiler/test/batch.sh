@@ -0,0 +1,14 @@
+# -batch 的测试: 多线程对 Semantic_Analysis/ 下的所有文件做语义分析,
+# 报错按文件路径的次序输出, 和 batch_semantic.txt 比较 (去掉最后一行的吞吐量统计)
+
+tmp=$(mktemp -d)
+../build/compiler -batch -semantic Semantic_Analysis -o $tmp -j=4 | sed '$d' > $tmp/out.txt
+if cmp -s $tmp/out.txt batch_semantic.txt; then
+    echo "PASS"
+    fail=0
+else
+    diff $tmp/out.txt batch_semantic.txt
+    fail=1
+fi
+rm -rf $tmp
+exit $fail